@@ -0,0 +1,174 @@
+#include "ccjson.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <random>
+#include <sstream>
+#include <sys/resource.h>
+using namespace json;
+
+// Benchmarks parse, dump, round-trip and DOM traversal. Prints one JSON
+// object per line. The standard corpora (canada.json, twitter.json,
+// citm_catalog.json) are read from the directory given on the command line
+// (default "data") when present; the synthetic sets are always generated.
+//
+//   make bench && ./bench data > bench_output.txt
+
+static size_t alloc_count = 0;
+static size_t alloc_bytes = 0;
+
+void* operator new(size_t size) {
+    ++alloc_count;
+    alloc_bytes += size;
+    if(void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"  // operator new above uses malloc
+#endif
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+struct Result {
+    double seconds;
+    size_t iterations;
+    size_t allocs;
+    size_t bytes;
+};
+
+// runs f until at least min_seconds have passed
+template <typename F>
+static Result measure(F f, double min_seconds = 0.5) {
+    using namespace std::chrono;
+    f();                                   // warm up
+    Result r { 0, 0, 0, 0 };
+    size_t count = alloc_count, bytes = alloc_bytes;
+    auto start = steady_clock::now();
+    do {
+        f();
+        ++r.iterations;
+        r.seconds = duration<double>(steady_clock::now() - start).count();
+    } while(r.seconds < min_seconds);
+    r.allocs = alloc_count - count;
+    r.bytes = alloc_bytes - bytes;
+    return r;
+}
+
+static void report(const std::string& corpus, const char* op, size_t size, const Result& r) {
+    Json::Jobject line;
+    line["corpus"] = Json(corpus);
+    line["op"] = Json(op);
+    line["bytes"] = Json(double(size));
+    line["iterations"] = Json(double(r.iterations));
+    line["mb_per_s"] = Json(size * r.iterations / r.seconds / (1024 * 1024));
+    line["allocs_per_op"] = Json(double(r.allocs / r.iterations));
+    line["alloc_bytes_per_op"] = Json(double(r.bytes / r.iterations));
+    line["peak_rss_kb"] = Json(double(peak_rss_kb()));
+    std::cout << Json(line).dump() << std::endl;
+}
+
+static size_t traverse(const Json& v) {
+    switch(v.get_type()) {
+        case Json::JNUMBER: return v.get_number() != 0;
+        case Json::JBOOL:   return v.get_bool();
+        case Json::JSTRING: return v.get_string().size();
+        case Json::JARRAY: {
+            size_t n = 1;
+            for(auto& e : v.get_array())
+                n += traverse(e);
+            return n;
+        }
+        case Json::JOBJECT: {
+            size_t n = 1;
+            for(auto& m : v.get_object())
+                n += m.first.size() + traverse(m.second);
+            return n;
+        }
+        default: return 1;
+    }
+}
+
+static void run(const std::string& corpus, const std::string& text) {
+    Json doc = Json::load(text);
+    std::string dumped = doc.dump();
+    volatile size_t sink = 0;
+
+    report(corpus, "parse", text.size(), measure([&] { sink += Json::load(text).is_null(); }));
+    report(corpus, "dump", dumped.size(), measure([&] { sink += doc.dump().size(); }));
+    report(corpus, "roundtrip", text.size(), measure([&] { sink += Json::load(text).dump().size(); }));
+    report(corpus, "traverse", text.size(), measure([&] { sink += traverse(doc); }));
+}
+
+static std::string numbers() {
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<double> real(-1e6, 1e6);
+    std::string out = "[";
+    for(int i = 0; i < 200000; ++i) {
+        if(i)
+            out += ',';
+        dump_number(i % 2 ? real(gen) : double(gen() % 100000), out);
+    }
+    return out + "]";
+}
+
+static std::string strings() {
+    std::mt19937 gen(42);
+    const char* pieces[] = { "plain", "with \\\"quote\\\"", "tab\\t", "\\u00e9t\\u00e9", "\xe4\xb8\xad\xe6\x96\x87",
+                             "\\ud834\\udd1e", "/path/to/x" };
+    std::string out = "[";
+    for(int i = 0; i < 100000; ++i) {
+        if(i)
+            out += ',';
+        out += '"';
+        for(int j = gen() % 6; j >= 0; --j)
+            out += pieces[gen() % 7];
+        out += '"';
+    }
+    return out + "]";
+}
+
+static std::string deep() {
+    std::string out = "[";
+    for(int i = 0; i < 1000; ++i) {
+        if(i)
+            out += ',';
+        out += std::string(150, '[') + "{\"k\":1}" + std::string(150, ']');
+    }
+    return out + "]";
+}
+
+static bool read_file(const std::string& path, std::string& out) {
+    std::ifstream in(path, std::ios::binary);
+    if(!in)
+        return false;
+    std::ostringstream bytes;
+    bytes << in.rdbuf();
+    out = bytes.str();
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    std::string dir = argc > 1 ? argv[1] : "data";
+    const char* corpora[] = { "canada.json", "twitter.json", "citm_catalog.json" };
+    for(const char* name : corpora) {
+        std::string text;
+        if(read_file(dir + "/" + name, text))
+            run(name, text);
+        else
+            std::cerr << "skipping " << dir << "/" << name << ": not found" << std::endl;
+    }
+    run("synthetic_numbers", numbers());
+    run("synthetic_strings", strings());
+    run("synthetic_deep", deep());
+    return 0;
+}
@@ -3,6 +3,32 @@
 #include <cstring>
 #include <cassert>
 #include <cmath>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <algorithm>
+#include <set>
+#include <regex>
+#include <atomic>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <list>
+#ifdef CCJSON_STATS
+#include <chrono>
+#endif
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef CCJSON_ZLIB
+#include <zlib.h>
+#endif
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace json {
 
@@ -16,6 +42,75 @@ namespace json {
 		bool operator<(Null)  const { return false; }
 	};
 
+	void dump_string(const string& v, string& out) {
+		dump_string(v.data(), v.size(), out);
+	}
+
+	void dump_string(const char* v, size_t n, string& out) {
+		out += '\"';
+		for(size_t i = 0; i < n; ++i) {
+			unsigned char ch = v[i];
+			switch (ch) {
+				case '\"': out += "\\\""; break;
+				case '\\': out += "\\\\"; break;
+				case '\b': out += "\\b";  break;
+				case '\f': out += "\\f";  break;
+				case '\n': out += "\\n";  break;
+				case '\r': out += "\\r";  break;
+				case '\t': out += "\\t";  break;
+				default:
+					if(static_cast<uint8_t>(ch) <= 0x1f) {
+						char buf[8];
+						snprintf(buf, sizeof(buf), "\\u%04x", ch);
+						out += buf;
+					} else if(static_cast<uint8_t>(ch) == 0xe2 && i + 2 < n && static_cast<uint8_t>(v[i+1]) == 0x80
+							  && static_cast<uint8_t>(v[i+2]) == 0xa8) {
+						out += "\\u2028";
+						i += 2;
+					} else if(static_cast<uint8_t>(ch) == 0xe2 && i + 2 < n && static_cast<uint8_t>(v[i+1]) == 0x80
+							  && static_cast<uint8_t>(v[i+2]) == 0xa9) {
+						out += "\\u2029";
+						i += 2;
+					} else
+						out += ch;
+			}
+		}
+		out += '\"';
+	}
+
+	void dump_number(double value, string& out) {
+		if(std::isfinite(value)) {
+			char buf[32];
+			snprintf(buf, sizeof(buf), "%.17g", value);
+			out += buf;
+		} else {
+			out += "null";
+		}
+	}
+
+	void dump_uint64(uint64_t value, string& out) {
+		char buf[20];
+		char* p = buf + sizeof(buf);
+		do {
+			*--p = static_cast<char>('0' + value % 10);
+			value /= 10;
+		} while(value);
+		out.append(p, buf + sizeof(buf));
+	}
+
+	void dump_int64(int64_t value, string& out) {
+		if(value < 0) {
+			out += '-';
+			dump_uint64(0 - static_cast<uint64_t>(value), out);
+		} else {
+			dump_uint64(static_cast<uint64_t>(value), out);
+		}
+	}
+
+	inline size_t hash_combine(size_t h, size_t v) {
+		return h ^ (v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2));
+	}
+
 	// wrapper class
 	template <Json::Jtype tag, typename T>
 	class Value: public JValue {
@@ -35,53 +130,48 @@ namespace json {
 		}
 
 		static void dump(const string& v, string& out) {
-        	out += '\"';
-        	for(size_t i = 0; i < v.length(); ++i) {
-            	unsigned char ch = v[i];
-            	switch (ch) {
-                	case '\"': out += "\\\""; break;
-                	case '\\': out += "\\\\"; break;
-                	case '\b': out += "\\b";  break;
-                	case '\f': out += "\\f";  break;
-                	case '\n': out += "\\n";  break;
-                	case '\r': out += "\\r";  break;
-                	case '\t': out += "\\t";  break;
-                	default:
-                		if(static_cast<uint8_t>(ch) <= 0x1f) {
-                			char buf[8];
-                			snprintf(buf, sizeof(buf), "\\u%04x", ch);
-                			out += buf;
-                		} else if(static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(v[i+1]) == 0x80
-                				  && static_cast<uint8_t>(v[i+2]) == 0xa8) {
-                			out += "\\u2028";
-                			i += 2;
-                		} else if(static_cast<uint8_t>(ch) == 0xe2 && static_cast<uint8_t>(v[i+1]) == 0x80
-                				  && static_cast<uint8_t>(v[i+2]) == 0xa9) {
-                			out += "\\u2029";
-                			i += 2;
-                		} else
-                			out += ch;
-            	}
-        	}
-        	out += '\"';
+			dump_string(v, out);
 		}
 
 		T m_value;
 	};
 
+	// NaN equals NaN and sorts after every other number. Shared by JDouble
+	// and JRawNumber, rhs is either.
+	inline bool number_equals(double a, double b) {
+		return a == b || (std::isnan(a) && std::isnan(b));
+	}
+	inline bool number_less(double a, double b) {
+		return std::isnan(b) ? !std::isnan(a) : a < b;
+	}
+	inline size_t number_hash(double v) {
+		if(std::isnan(v))
+			return hash_combine(Json::JNUMBER, 0x7ff8);
+		return hash_combine(Json::JNUMBER, std::hash<double>()(v == 0 ? 0.0 : v));
+	}
+	inline int64_t number_int64(double v) {
+		if(!(v >= -9223372036854775808.0 && v < 9223372036854775808.0))
+			throw std::out_of_range("NUMBER_OUT_OF_RANGE");
+		return static_cast<int64_t>(v);
+	}
+
 	class JDouble final: public Value<Json::JNUMBER, double> {
 	public:
 		explicit JDouble(double value): Value(value) {}
 	private:
 		double get_number() const override { return m_value; }
+		int64_t get_int64() const override { return number_int64(m_value); }
+		bool equals(const JValue* rhs) const override {
+			return number_equals(m_value, rhs->get_number());
+		}
+		bool less(const JValue* rhs) const override {
+			return number_less(m_value, rhs->get_number());
+		}
+		size_t hash() const override {
+			return number_hash(m_value);
+		}
 		static void dump(double value, string& out) {
-			if(std::isfinite(value)) {
-				char buf[32];
-				snprintf(buf, sizeof(buf), "%.17g", value);
-				out += buf;
-			} else {
-				out += "null";
-			}
+			dump_number(value, out);
 		}
 
 		void dump(std::string& out) const {
@@ -90,7 +180,47 @@ namespace json {
 
 		void set_value(double v) {
 			m_value = v;
+			touch();
+		}
+	};
+
+	// number kept as its source text and converted on every read, see
+	// PARSE_RAW_NUMBERS
+	class JRawNumber final: public JValue {
+	public:
+		explicit JRawNumber(string text): m_text(move(text)) {}
+		const string& text() const { return m_text; }
+	private:
+		Json::Jtype get_type() const override { return Json::JNUMBER; }
+		double get_number() const override { return strtod(m_text.c_str(), nullptr); }
+		int64_t get_int64() const override {
+			if(m_text.find_first_of(".eE") != string::npos)
+				return number_int64(get_number());
+			errno = 0;
+			long long v = strtoll(m_text.c_str(), nullptr, 10);
+			if(errno == ERANGE)
+				throw std::out_of_range("NUMBER_OUT_OF_RANGE");
+			return v;
+		}
+		bool equals(const JValue* rhs) const override {
+			return number_equals(get_number(), rhs->get_number());
+		}
+		bool less(const JValue* rhs) const override {
+			return number_less(get_number(), rhs->get_number());
+		}
+		size_t hash() const override {
+			return number_hash(get_number());
 		}
+		void dump(string& out) const override {
+			out += m_text;
+		}
+		void set_value(double v) override {
+			m_text.clear();
+			dump_number(v, m_text);
+			touch();
+		}
+
+		string m_text;
 	};
 
 	class JBool final: public Value<Json::JBOOL, bool> {
@@ -98,6 +228,9 @@ namespace json {
 		explicit JBool(bool value): Value(value) {}
 	private:
 		bool get_bool() const override { return m_value; }
+		size_t hash() const override {
+			return hash_combine(Json::JBOOL, m_value);
+		}
 		static void dump(bool value, string& out) {
 			out += value ? "true" : "false";
 		}
@@ -108,6 +241,7 @@ namespace json {
 
 		void set_value(bool v) {
 			m_value = v;
+			touch();
 		} 
 	};
 
@@ -117,6 +251,9 @@ namespace json {
 		explicit JString(string&& value): Value(move(value)) {}
 	private:
 		const string& get_string() const override { return m_value; }
+		size_t hash() const override {
+			return hash_combine(Json::JSTRING, std::hash<string>()(m_value));
+		}
 
 		void dump(string& out) const {
 			Value::dump(m_value, out); 
@@ -124,11 +261,95 @@ namespace json {
 
 		void set_value(const string& v) {
 			m_value = v;
+			touch();
 		}
 		void set_value(string&& v) {
 			m_value = move(v);
+			touch();
+		}
+	};
+
+#ifdef CCJSON_NODE_CACHE
+	namespace {
+		// id of the outermost hash() or dump() running on this thread, so a
+		// shared subtree is revalidated once per call however often reached
+		std::atomic<uint64_t> cache_passes(0);
+		thread_local uint64_t cache_pass = 0;
+		thread_local int cache_nesting = 0;
+
+		struct JCachePass {
+			JCachePass() {
+				if(cache_nesting++ == 0)
+					cache_pass = ++cache_passes;
+			}
+			~JCachePass() {
+				--cache_nesting;
+			}
+		};
+	}
+
+	// handed out in blocks so that most calls stay thread local
+	uint64_t JValue::new_version() {
+		static std::atomic<uint64_t> versions(0);
+		thread_local uint64_t next = 0, limit = 0;
+		if(next == limit) {
+			next = versions.fetch_add(1024, std::memory_order_relaxed) + 1;
+			limit = next + 1024;
+		}
+		return next++;
+	}
+
+	// hash and text cached in an array or object. They stay valid while the
+	// container and its children are the same nodes at the same versions as
+	// when they were filled; a child whose own subtree changed bumps its
+	// version on refresh, so changes deep down reach every ancestor.
+	struct JNodeCache {
+		std::vector<std::pair<const JValue*, uint64_t>> children;
+		uint64_t version = 0;                // owner's version when filled
+		uint64_t pass = 0;                   // last pass that refreshed it
+#ifdef CCJSON_HASH_CACHE
+		size_t hash = 0;                     // 0 until computed
+#endif
+#ifdef CCJSON_DUMP_CACHE
+		string text;                         // dump output, empty until dumped
+#endif
+
+		static const Json& child(const Json& v) { return v; }
+		static const Json& child(const Json::Jobject::value_type& v) { return v.second; }
+
+		template <typename T>
+		void refresh(const JValue& owner, const T& values) {
+			if(pass == cache_pass)
+				return;
+			pass = cache_pass;
+			bool fresh = version == owner.m_version && children.size() == values.size();
+			size_t i = 0;
+			for(auto& v : values) {
+				const JValue* node = child(v).m_ptr.get();
+				node->refresh();
+				if(fresh && (children[i].first != node || children[i].second != node->m_version))
+					fresh = false;
+				++i;
+			}
+			if(fresh)
+				return;
+
+			children.clear();
+			children.reserve(values.size());
+			for(auto& v : values) {
+				const JValue* node = child(v).m_ptr.get();
+				children.emplace_back(node, node->m_version);
+			}
+			version = owner.m_version = JValue::new_version();
+#ifdef CCJSON_HASH_CACHE
+			hash = 0;
+#endif
+#ifdef CCJSON_DUMP_CACHE
+			text.clear();
+#endif
 		}
 	};
+#endif
 
 	class JArray final: public Value<Json::JARRAY, Json::Jarray> {
 	public:
@@ -138,6 +359,19 @@ namespace json {
 		const Json::Jarray& get_array() const override { return m_value; }
 		const Json& operator[](size_t i) const override;
 		Json& operator[](size_t i) override;
+		size_t hash() const override {
+#ifdef CCJSON_HASH_CACHE
+			if(m_cache.hash)
+				return m_cache.hash;
+#endif
+			size_t h = Json::JARRAY;
+			for(auto& v : m_value)
+				h = hash_combine(h, v.hash());
+#ifdef CCJSON_HASH_CACHE
+			m_cache.hash = h ? h : 1;
+#endif
+			return h;
+		}
 		static void dump(const Json::Jarray& values, string& out) {
 			out += "[";
 			for(size_t i = 0; i < values.size(); ++i) {
@@ -150,15 +384,31 @@ namespace json {
 		}
 
 		void dump(string& out) const {
+#ifdef CCJSON_DUMP_CACHE
+			if(m_cache.text.empty())
+				dump(m_value, m_cache.text);
+			out += m_cache.text;
+#else
 			dump(m_value, out);
+#endif
 		}
 
 		void set_value(const Json::Jarray& v) {
+			touch();
 			m_value = v;
 		}
 		void set_value(Json::Jarray&& v) {
+			touch();
 			m_value = move(v);
 		}
+
+#ifdef CCJSON_NODE_CACHE
+		void refresh() const override {
+			m_cache.refresh(*this, m_value);
+		}
+
+		mutable JNodeCache m_cache;
+#endif
 	};
 
 	class JObject final: public Value<Json::JOBJECT, Json::Jobject> {
@@ -169,6 +419,21 @@ namespace json {
 		const Json::Jobject& get_object() const override { return m_value; }
 		const Json& operator[](const string& key) const override;
 		Json& operator[](const string& key) override;
+		size_t hash() const override {
+#ifdef CCJSON_HASH_CACHE
+			if(m_cache.hash)
+				return m_cache.hash;
+#endif
+			size_t h = Json::JOBJECT;
+			for(auto& member : m_value) {
+				h = hash_combine(h, std::hash<string>()(member.first));
+				h = hash_combine(h, member.second.hash());
+			}
+#ifdef CCJSON_HASH_CACHE
+			m_cache.hash = h ? h : 1;
+#endif
+			return h;
+		}
 		static void dump(const Json::Jobject& values, string& out) {
 			out += "{";
 			for(auto iter = values.cbegin(); iter != values.cend(); ++iter) {
@@ -183,15 +448,31 @@ namespace json {
 		}
 
 		void dump(std::string& out) const {
+#ifdef CCJSON_DUMP_CACHE
+			if(m_cache.text.empty())
+				dump(m_value, m_cache.text);
+			out += m_cache.text;
+#else
 			dump(m_value, out);
+#endif
 		}
 
 		void set_value(const Json::Jobject& v) {
+			touch();
 			m_value = v;
 		}
 		void set_value(Json::Jobject&& v) {
+			touch();
 			m_value = move(v);
 		}
+
+#ifdef CCJSON_NODE_CACHE
+		void refresh() const override {
+			m_cache.refresh(*this, m_value);
+		}
+
+		mutable JNodeCache m_cache;
+#endif
 	};
 
 	class JNull final: public Value<Json::JNULL, Null> {
@@ -202,25 +483,227 @@ namespace json {
 			out += "null";
 		}
 
+		size_t hash() const override {
+			return hash_combine(Json::JNULL, 0);
+		}
+
 		void dump(std::string& out) const {
 			dump(Null(), out);
 		}
 	};
 
+	// node allocation
+#if defined(CCJSON_ALLOC_STATS) && defined(CCJSON_SINGLE_THREADED)
+#error "CCJSON_ALLOC_STATS counts shared_ptr allocations, build it without CCJSON_SINGLE_THREADED"
+#endif
+
+#ifdef CCJSON_ALLOC_STATS
+	namespace {
+		std::atomic<uint64_t> alloc_allocations(0), alloc_deallocations(0);
+		std::atomic<uint64_t> alloc_bytes_allocated(0), alloc_bytes_freed(0);
+
+		template <typename T>
+		struct JCountingAllocator {
+			typedef T value_type;
+			JCountingAllocator() noexcept {}
+			template <typename U> JCountingAllocator(const JCountingAllocator<U>&) noexcept {}
+
+			T* allocate(size_t n) {
+				alloc_allocations.fetch_add(1, std::memory_order_relaxed);
+				alloc_bytes_allocated.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+				return std::allocator<T>().allocate(n);
+			}
+			void deallocate(T* p, size_t n) noexcept {
+				alloc_deallocations.fetch_add(1, std::memory_order_relaxed);
+				alloc_bytes_freed.fetch_add(n * sizeof(T), std::memory_order_relaxed);
+				std::allocator<T>().deallocate(p, n);
+			}
+			template <typename U> bool operator==(const JCountingAllocator<U>&) const noexcept { return true; }
+			template <typename U> bool operator!=(const JCountingAllocator<U>&) const noexcept { return false; }
+		};
+	}
+
+	template <typename T, typename... Args>
+	JHandle make_node(Args&&... args) {
+		return std::allocate_shared<T>(JCountingAllocator<T>(), std::forward<Args>(args)...);
+	}
+
+	JAllocStats alloc_stats() {
+		return JAllocStats { alloc_allocations.load(std::memory_order_relaxed),
+							 alloc_deallocations.load(std::memory_order_relaxed),
+							 alloc_bytes_allocated.load(std::memory_order_relaxed),
+							 alloc_bytes_freed.load(std::memory_order_relaxed) };
+	}
+#else
+	template <typename T, typename... Args>
+	JHandle make_node(Args&&... args) {
+#ifdef CCJSON_SINGLE_THREADED
+		return JHandle(new T(std::forward<Args>(args)...));
+#else
+		return std::make_shared<T>(std::forward<Args>(args)...);
+#endif
+	}
+
+	JAllocStats alloc_stats() {
+		return JAllocStats { 0, 0, 0, 0 };
+	}
+#endif
+
+	// what a moved-from Json points to, one per thread so that moves do not
+	// contend on a shared refcount
+	const JHandle& moved_from_node() {
+		static thread_local const JHandle node = make_node<JNull>();
+		return node;
+	}
+
+#ifdef CCJSON_STATS
+#define CCJSON_STAT(stmt) do { if(stats) { stmt; } } while(0)
+
+	namespace {
+		std::mutex stats_mutex;
+		JStats stats_total = {};
+		JStatsHook stats_hook = nullptr;
+		void* stats_user = nullptr;
+
+		int latency_bucket(uint64_t ns) {
+			int i = 0;
+			for(uint64_t us = ns / 1000; us && i < JStats::buckets - 1; us >>= 1)
+				++i;
+			return i;
+		}
+
+		void stat_value(JStats& s, char first, int depth) {
+			switch(first) {
+				case 'n': ++s.values[Json::JNULL]; break;
+				case 't':
+				case 'f': ++s.values[Json::JBOOL]; break;
+				case '\"': ++s.values[Json::JSTRING]; break;
+				case '[': ++s.values[Json::JARRAY]; break;
+				case '{': ++s.values[Json::JOBJECT]; break;
+				default:  ++s.values[Json::JNUMBER]; break;
+			}
+			s.max_depth = std::max<uint64_t>(s.max_depth, depth);
+		}
+
+		void stat_record(const JStats& call) {
+			JStatsHook hook;
+			void* user;
+			{
+				std::lock_guard<std::mutex> lock(stats_mutex);
+				JStats& t = stats_total;
+				t.parse_calls += call.parse_calls;
+				t.parse_bytes += call.parse_bytes;
+				t.parse_ns += call.parse_ns;
+				t.dump_calls += call.dump_calls;
+				t.dump_bytes += call.dump_bytes;
+				t.dump_ns += call.dump_ns;
+				for(int i = 0; i < 6; ++i)
+					t.values[i] += call.values[i];
+				t.string_bytes += call.string_bytes;
+				t.number_bytes += call.number_bytes;
+				t.max_depth = std::max(t.max_depth, call.max_depth);
+				for(int i = 0; i < JStats::buckets; ++i) {
+					t.parse_latency[i] += call.parse_latency[i];
+					t.dump_latency[i] += call.dump_latency[i];
+				}
+				hook = stats_hook;
+				user = stats_user;
+			}
+			if(hook)
+				hook(call, user);
+		}
+
+		uint64_t elapsed_ns(std::chrono::steady_clock::time_point start) {
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		// times one load; records on unwind too, so failed parses are counted
+		struct JParseScope {
+			JStats call;
+			size_t bytes;
+			std::chrono::steady_clock::time_point start;
+
+			JParseScope(JStats*& slot, size_t n) : call(), bytes(n), start(std::chrono::steady_clock::now()) {
+				slot = &call;
+			}
+			~JParseScope() {
+				call.parse_calls = 1;
+				call.parse_bytes = bytes;
+				call.parse_ns = elapsed_ns(start);
+				++call.parse_latency[latency_bucket(call.parse_ns)];
+				stat_record(call);
+			}
+		};
+
+		// times the outermost dump only; containers dump their children through Json::dump
+		thread_local int dump_nesting = 0;
+
+		struct JDumpScope {
+			const string& out;
+			size_t size;
+			bool outer;
+			std::chrono::steady_clock::time_point start;
+
+			explicit JDumpScope(const string& o) : out(o), size(o.size()), outer(dump_nesting++ == 0) {
+				if(outer)
+					start = std::chrono::steady_clock::now();
+			}
+			~JDumpScope() {
+				if(--dump_nesting || !outer)
+					return;
+				JStats call = {};
+				call.dump_calls = 1;
+				call.dump_bytes = out.size() - size;
+				call.dump_ns = elapsed_ns(start);
+				++call.dump_latency[latency_bucket(call.dump_ns)];
+				stat_record(call);
+			}
+		};
+	}
+
+	JStats stats() {
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		return stats_total;
+	}
+
+	void reset_stats() {
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		stats_total = JStats();
+	}
+
+	void set_stats_hook(JStatsHook hook, void* user) {
+		std::lock_guard<std::mutex> lock(stats_mutex);
+		stats_hook = hook;
+		stats_user = user;
+	}
+#else
+#define CCJSON_STAT(stmt) do {} while(0)
+
+	JStats stats() {
+		return JStats();
+	}
+
+	void reset_stats() {}
+
+	void set_stats_hook(JStatsHook, void*) {}
+#endif
+
 	// Json
-	Json::Json() noexcept                  : m_ptr(std::make_shared<JNull>()) {}
-	Json::Json(double value)               : m_ptr(std::make_shared<JDouble>(value)) {}
-	Json::Json(bool value)                 : m_ptr(std::make_shared<JBool>(value)) {}
-	Json::Json(const string& value)        : m_ptr(std::make_shared<JString>(value)) {}
-	Json::Json(string&& value)             : m_ptr(std::make_shared<JString>(move(value))) {}
-	Json::Json(const char* value)          : m_ptr(std::make_shared<JString>(string(value))) {}
-	Json::Json(const Json::Jarray& value)  : m_ptr(std::make_shared<JArray>(value)) {}
-	Json::Json(Json::Jarray&& value)       : m_ptr(std::make_shared<JArray>(move(value))) {}
-	Json::Json(const Json::Jobject& value) : m_ptr(std::make_shared<JObject>(value)) {}
-	Json::Json(Json::Jobject&& value)      : m_ptr(std::make_shared<JObject>(move(value))) {}
+	Json::Json() noexcept                  : m_ptr(make_node<JNull>()) {}
+	Json::Json(Json&& t) noexcept          : m_ptr(move(t.m_ptr)) { t.m_ptr = moved_from_node(); }
+	Json::Json(double value)               : m_ptr(make_node<JDouble>(value)) {}
+	Json::Json(bool value)                 : m_ptr(make_node<JBool>(value)) {}
+	Json::Json(const string& value)        : m_ptr(make_node<JString>(value)) {}
+	Json::Json(string&& value)             : m_ptr(make_node<JString>(move(value))) {}
+	Json::Json(const char* value)          : m_ptr(make_node<JString>(string(value))) {}
+	Json::Json(const Json::Jarray& value)  : m_ptr(make_node<JArray>(value)) {}
+	Json::Json(Json::Jarray&& value)       : m_ptr(make_node<JArray>(move(value))) {}
+	Json::Json(const Json::Jobject& value) : m_ptr(make_node<JObject>(value)) {}
+	Json::Json(Json::Jobject&& value)      : m_ptr(make_node<JObject>(move(value))) {}
 
 	Json::Jtype Json::get_type()            const { return m_ptr->get_type(); }
 	double Json::get_number()               const { return m_ptr->get_number(); }
+	int64_t Json::get_int64()               const { return m_ptr->get_int64(); }
 	bool Json::get_bool()                   const { return m_ptr->get_bool(); }
 	const string& Json::get_string()        const { return m_ptr->get_string(); }
 	const Json::Jarray& Json::get_array()   const { return m_ptr->get_array(); }
@@ -228,70 +711,70 @@ namespace json {
 
 	void Json::set_value() {
 		if(!is_null()) {
-			m_ptr = std::make_shared<JNull>();
+			m_ptr = make_node<JNull>();
 		}
 	}
 	void Json::set_value(double value) {
 		if(is_number()) {
 			m_ptr->set_value(value);
 		} else {
-			m_ptr = std::make_shared<JDouble>(value);
+			m_ptr = make_node<JDouble>(value);
 		}
 	}
 	void Json::set_value(bool value) {
 		if(is_bool()) {
 			m_ptr->set_value(value);
 		} else {
-			m_ptr = std::make_shared<JBool>(value);
+			m_ptr = make_node<JBool>(value);
 		}
 	}
 	void Json::set_value(const string& value) {
 		if(is_string()) {
 			m_ptr->set_value(value);
 		} else {
-			m_ptr = std::make_shared<JString>(value);
+			m_ptr = make_node<JString>(value);
 		}
 	}
 	void Json::set_value(string&& value) {
 		if(is_string()) {
-			m_ptr->set_value(value);
+			m_ptr->set_value(move(value));
 		} else {
-			m_ptr = std::make_shared<JString>(value);
+			m_ptr = make_node<JString>(move(value));
 		}
 	}
 	void Json::set_value(const char* value) {
 		if(is_string()) {
 			m_ptr->set_value(string(value));
 		} else {
-			m_ptr = std::make_shared<JString>(string(value));
+			m_ptr = make_node<JString>(string(value));
 		}
 	}
 	void Json::set_value(const Jarray& value) {
 		if(is_array()) {
 			m_ptr->set_value(value);
 		} else {
-			m_ptr = std::make_shared<JArray>(value);
+			m_ptr = make_node<JArray>(value);
 		}
  	}
  	void Json::set_value(Jarray&& value) {
  		if(is_array()) {
- 			m_ptr->set_value(value);
+ 			m_ptr->set_value(move(value));
  		} else {
- 			m_ptr = std::make_shared<JArray>(value);
+ 			m_ptr = make_node<JArray>(move(value));
  		}
  	}
  	void Json::set_value(const Jobject& value) {
  		if(is_object()) {
  			m_ptr->set_value(value);
  		} else {
- 			m_ptr = std::make_shared<JObject>(value);
+ 			m_ptr = make_node<JObject>(value);
  		}
  	}
  	void Json::set_value(Jobject&& value) {
  		if(is_object()) {
- 			m_ptr->set_value(value);
+ 			m_ptr->set_value(move(value));
  		} else {
- 			m_ptr = std::make_shared<JObject>(value);
+ 			m_ptr = make_node<JObject>(move(value));
  		}
  	}
 
@@ -310,6 +793,7 @@ namespace json {
 
  	// JValue
  	double JValue::get_number()                       const { throw std::runtime_error("NOT_NUMBER"); }
+ 	int64_t JValue::get_int64()                       const { throw std::runtime_error("NOT_NUMBER"); }
  	bool JValue::get_bool()                           const { throw std::runtime_error("NOT_BOOL"); }
  	const string& JValue::get_string()                const { throw std::runtime_error("NOT_STRING"); }
  	const Json::Jarray& JValue::get_array()           const { throw std::runtime_error("NOT_ARRAY"); }
@@ -329,16 +813,49 @@ namespace json {
 
     // Json
  	Json& Json::operator=(const Json& rhs) {
- 		std::shared_ptr<JValue> tmp(rhs.m_ptr);
- 		m_ptr = tmp;
+ 		m_ptr = rhs.m_ptr;
  		return *this;
  	}
  	Json& Json::operator=(Json&& rhs) {
- 		std::shared_ptr<JValue> tmp(rhs.m_ptr);
- 		m_ptr = move(tmp);
+ 		if(this != &rhs) {
+ 			m_ptr = move(rhs.m_ptr);
+ 			rhs.m_ptr = moved_from_node();
+ 		}
  		return *this;
  	}
 
+ 	// builder
+ 	Json::Jarray& Json::mutable_array() {
+ 		Jarray* a = array_ptr();
+ 		if(!a)
+ 			throw std::runtime_error("NOT_ARRAY");
+ 		return *a;
+ 	}
+ 	Json::Jobject& Json::mutable_object() {
+ 		Jobject* o = object_ptr();
+ 		if(!o)
+ 			throw std::runtime_error("NOT_OBJECT");
+ 		return *o;
+ 	}
+ 	void Json::push_back(const Json& value) {
+ 		mutable_array().push_back(value);
+ 	}
+ 	void Json::push_back(Json&& value) {
+ 		mutable_array().push_back(move(value));
+ 	}
+ 	void Json::reserve(size_t n) {
+ 		mutable_array().reserve(n);
+ 	}
+ 	Json& Json::insert_or_assign(string key, Json value) {
+ 		Jobject& o = mutable_object();
+ 		auto iter = o.lower_bound(key);
+ 		if(iter != o.end() && iter->first == key)
+ 			iter->second = move(value);
+ 		else
+ 			iter = o.emplace_hint(iter, move(key), move(value));
+ 		return iter->second;
+ 	}
+
  	bool Json::operator==(const Json& rhs) const {
  		if(m_ptr == rhs.m_ptr)
  			return true;
@@ -351,14 +868,23 @@ namespace json {
  		if(m_ptr == rhs.m_ptr)
  			return false;
  		if(m_ptr->get_type() != rhs.m_ptr->get_type())
- 			return false;
+ 			return m_ptr->get_type() < rhs.m_ptr->get_type();
  		return m_ptr->less(rhs.m_ptr.get());
  	}
 
+ 	size_t Json::hash() const {
+#ifdef CCJSON_NODE_CACHE
+ 		JCachePass pass;
+ 		m_ptr->refresh();
+#endif
+ 		return m_ptr->hash();
+ 	}
+
  	const Json& JArray::operator[](size_t i) const {
  		return m_value[i];
  	}
  	Json& JArray::operator[](size_t i) {
+ 		touch();
  		return m_value[i];
  	}
 
@@ -366,12 +892,97 @@ namespace json {
  		return m_value.at(key);
  	}
  	Json& JObject::operator[](const string& key) {
+ 		touch();
  		return m_value.at(key);
  	}
 
- 	namespace {
+	// schema
+	struct JSchema::Node {
+		unsigned types = ~0u;                      // bit per Json::Jtype
+		bool integer = false;
+		double minimum = -HUGE_VAL, maximum = HUGE_VAL;                      // inclusive
+		double exclusive_minimum = -HUGE_VAL, exclusive_maximum = HUGE_VAL;
+		size_t min_length = 0, max_length = static_cast<size_t>(-1);
+		size_t min_items = 0, max_items = static_cast<size_t>(-1);
+		std::unique_ptr<std::regex> pattern;
+		size_t pattern_max_input = 0;              // longer strings are not matched
+		std::set<Json> enums;
+		std::map<string, std::unique_ptr<Node>> properties;
+		std::map<string, size_t> required;         // key -> bit in the found mask
+		std::unique_ptr<Node> items;
+	};
+
+	namespace {
+		const char* schema_check_type(const JSchema::Node& node, Json::Jtype t) {
+			return (node.types >> t) & 1 ? nullptr : "SCHEMA_TYPE_MISMATCH";
+		}
+		const char* schema_check_number(const JSchema::Node& node, double v) {
+			if(node.integer && std::floor(v) != v)
+				return "SCHEMA_TYPE_MISMATCH";
+			if(v < node.minimum || v <= node.exclusive_minimum)
+				return "SCHEMA_BELOW_MINIMUM";
+			if(v > node.maximum || v >= node.exclusive_maximum)
+				return "SCHEMA_ABOVE_MAXIMUM";
+			return nullptr;
+		}
+		const char* schema_check_string(const JSchema::Node& node, const string& v) {
+			if(node.min_length > 0 || node.max_length != static_cast<size_t>(-1)) {
+				size_t n = 0;
+				for(unsigned char ch : v)
+					n += (ch & 0xC0) != 0x80;          // code points
+				if(n < node.min_length || n > node.max_length)
+					return "SCHEMA_LENGTH_OUT_OF_RANGE";
+			}
+			if(node.pattern && v.size() > node.pattern_max_input)
+				return "SCHEMA_PATTERN_INPUT_TOO_LONG";
+			if(node.pattern && !std::regex_search(v, *node.pattern))
+				return "SCHEMA_PATTERN_MISMATCH";
+			return nullptr;
+		}
+		const char* schema_check_enum(const JSchema::Node& node, const Json& v) {
+			if(!node.enums.empty() && node.enums.find(v) == node.enums.end())
+				return "SCHEMA_NOT_IN_ENUM";
+			return nullptr;
+		}
+	}
+
+	// projection
+ 	struct JProjection::Node {
+ 		bool whole = false;
+ 		std::map<string, std::unique_ptr<Node>> keys;
+ 		std::map<size_t, const Node*> indices;
+ 	};
+
+ 	JProjection::JProjection(const std::vector<JPointer>& paths) {
+ 		std::shared_ptr<Node> root = std::make_shared<Node>();
+ 		for(auto& path : paths) {
+ 			Node* node = root.get();
+ 			for(auto& t : path.m_tokens) {
+ 				if(node->whole)
+ 					break;
+ 				std::unique_ptr<Node>& child = node->keys[t.key];
+ 				if(!child)
+ 					child.reset(new Node());
+ 				if(t.index < JPointer::end)
+ 					node->indices[t.index] = child.get();
+ 				node = child.get();
+ 			}
+ 			node->whole = true;
+ 			node->keys.clear();
+ 			node->indices.clear();
+ 		}
+ 		m_root = root;
+ 	}
+
  		struct JParser final {
  			const char* cur;
+ 			const char* end;          // input end when known, enables block scans
+ 			unsigned flags;           // JParseFlags
+ 			const char* error;        // set by fail()
+ 			const char* error_at;
+#ifdef CCJSON_STATS
+ 			JStats* stats;        // per call counters, null outside load
+#endif
 
  			void expect(const char* &c, char ch) {
         		assert(*c == ch);
@@ -384,62 +995,120 @@ namespace json {
         		while(*cur == ' ' || *cur == '\t' || *cur == '\n' || *cur == '\r')
             		++cur;
     		}
-    		Json parse_json() {
+    		// the core grammar reports errors through fail() instead of throwing,
+    		// so malformed input costs no unwinding; error_at marks the offending byte
+    		bool fail(const char* code) {
+    			return fail(code, cur);
+    		}
+    		bool fail(const char* code, const char* at) {
+    			error = code;
+    			error_at = at;
+    			return false;
+    		}
+    		void check(bool ok) const {
+    			if(!ok)
+    				throw std::logic_error(error);
+    		}
+    		bool parse_json(Json& result) {
+    			parse_whitespace();
+    			if(!parse_value(0, result))
+    				return false;
+    			parse_whitespace();
+    			if(*cur != '\0')
+    				return fail("PARSE_ROOT_NOT_SINGULAR");
+    			return true;
+    		}
+    		Json parse_json(const JProjection::Node& root) {
     			parse_whitespace();
-    			Json result = parse_value(0);
+    			Json result;
+    			parse_projected(0, root, result);
     			parse_whitespace();
     			if(*cur != '\0') {
     				throw std::logic_error("PARSE_ROOT_NOT_SINGULAR");
     			}
     			return result;
     		}
-    		Json parse_value(int depth) {
+    		bool parse_value(int depth, Json& out) {
     			if(depth > max_depth)
-    				throw std::logic_error("EXCEEDED_MAXIMUM_NESTING_DEPTH");
+    				return fail("EXCEEDED_MAXIMUM_NESTING_DEPTH");
+        		CCJSON_STAT(stat_value(*stats, *cur, depth));
         		switch(*cur) {
-            		case 'n': return parse_literal("null", Json::JNULL);
-            		case 't': return parse_literal("true", Json::JBOOL);
-            		case 'f': return parse_literal("false", Json::JBOOL);
-            		case '\"': return parse_string();
-            		case '[': return parse_array(depth);
-            		case '{': return parse_object(depth);
-            		default:  return parse_number();
-            		case '\0': throw std::logic_error("PARSE_EXPECT_VALUE");
+            		case 'n': return parse_literal("null", out);
+            		case 't': return parse_literal("true", out);
+            		case 'f': return parse_literal("false", out);
+            		case '\"': return parse_string(out);
+            		case '[': return parse_array(depth, out);
+            		case '{': return parse_object(depth, out);
+            		default:  return parse_number(out);
+            		case '\0': return fail("PARSE_EXPECT_VALUE");
         		}
     		}
-    		Json parse_literal(const char* literal, Json::Jtype t) {
+    		bool match_literal(const char* literal) {
     			expect(cur, literal[0]);
         		size_t i;
         		for(i=0; literal[i+1]; ++i) {
             		if(cur[i] != literal[i+1])
-                		throw std::logic_error("PARSE_INVALID_VALUE");
+                		return fail("PARSE_INVALID_VALUE", cur - 1);
         		}
         		cur += i;
+        		return true;
+    		}
+    		bool parse_literal(const char* literal, Json& out) {
+    			if(!match_literal(literal))
+    				return false;
         		if(strcmp(literal, "true") == 0)
-            		return true;
+            		out = true;
         		else if(strcmp(literal, "false") == 0)
-            		return false;
-            	else if(strcmp(literal, "null") == 0)
-            		return Json();
-            	return Json();
+            		out = false;
+            	else
+            		out = Json();
+            	return true;
     		}
-    		Json parse_number() {
-        		const char* p = cur;
+    		bool parse_number(Json& out) {
+    			if(flags & PARSE_RAW_NUMBERS) {
+    				const char* p = cur;
+    				if(!scan_finite_number(p))
+    					return false;
+    				CCJSON_STAT(stats->number_bytes += p - cur);
+    				out.m_ptr = make_node<JRawNumber>(string(cur, p));
+    				cur = p;
+    				return true;
+    			}
+    			double v;
+    			if(!parse_double(v))
+    				return false;
+    			out = v;
+    			return true;
+    		}
+    		bool parse_double(double& v) {
+    			const char* p = cur;
+    			if(!scan_number(p))
+    				return false;
+        		errno = 0;
+        		v = strtod(cur, nullptr);
+        		if(errno == ERANGE && (v == HUGE_VAL || v == -HUGE_VAL))
+            		return fail("PARSE_NUMBER_TOO_BIG");
+        		CCJSON_STAT(stats->number_bytes += p - cur);
+        		cur = p;
+        		return true;
+    		}
+    		// moves p past the number grammar starting at cur
+    		bool scan_number(const char*& p) {
         		if(*p == '-') ++p;
         		if(*p == '0') {
         			++p;
         			if(isdigit(*p))
-        				throw std::logic_error("PARSE_INVALID_VALUE");
+        				return fail("PARSE_INVALID_VALUE");
         		} else {
             		if(!isdigit09(*p))
-                		throw std::logic_error("PARSE_INVALID_VALUE");
+                		return fail("PARSE_INVALID_VALUE");
             		for(++p; isdigit(*p); ++p)
                 		;
         		}
 
         		if(*p == '.') {
             		if(!isdigit(*++p))
-                		throw std::logic_error("PARSE_INVALID_VALUE");
+                		return fail("PARSE_INVALID_VALUE");
             		for(++p; isdigit(*p); ++p)
                 		;
         		}
@@ -449,29 +1118,48 @@ namespace json {
             		if(*p == '+' || *p == '-')
                 		++p;
             		if(!isdigit(*p))
-                		throw std::logic_error("PARSE_INVALID_VALUE");
+                		return fail("PARSE_INVALID_VALUE");
             		for(++p; isdigit(*p); ++p)
                 		;
         		}
-        		errno = 0;
-        		double v = strtod(cur, nullptr);
-        		if(errno == ERANGE && (v == HUGE_VAL || v == -HUGE_VAL))
-            		throw std::logic_error("PARSE_NUMBER_TOO_BIG");
-        		cur = p;
-        		return v;
+        		return true;
     		}
-
-    		string parse_string() {
+    		// scan_number, also failing where parse_double would: overflow
+    		// to infinity needs an exponent or at least 309 digits, so only
+    		// those pay for strtod
+    		bool scan_finite_number(const char*& p) {
+    			const char* start = p;
+    			if(!scan_number(p))
+    				return false;
+    			if(p - start >= 309 || std::any_of(start, p, [](char c) { return c == 'e' || c == 'E'; })) {
+    				errno = 0;
+    				double v = strtod(start, nullptr);
+    				if(errno == ERANGE && (v == HUGE_VAL || v == -HUGE_VAL))
+    					return fail("PARSE_NUMBER_TOO_BIG");
+    			}
+    			return true;
+    		}
+    		bool parse_string(Json& out) {
+    			string v;
+    			if(!parse_string(v))
+    				return false;
+    			out = move(v);
+    			return true;
+    		}
+    		bool parse_string(string& tmp) {
     			expect(cur, '\"');
         		const char* p = cur;
-        		string tmp;
         		unsigned u = 0, u2 = 0;
+        		tmp.clear();
         		for(;;) {
+        			const char* run = p;
+        			p = scan_plain(p);
+        			tmp.append(run, p);
             		char ch = *p++;
 		            if(ch == '\"')
 		                break;
 		            else if(ch == '\0')
-		                throw std::logic_error("PARSE_MISS_QUOTATION_MARK");
+		                return fail("PARSE_MISS_QUOTATION_MARK", p - 1);
 		            else if(ch == '\\' && p) {
 		                switch(*p++) {
 		                    case '\"': tmp += '\"'; break;
@@ -483,32 +1171,97 @@ namespace json {
 		                    case 'r':  tmp += '\r'; break;
 		                    case 't':  tmp += '\t'; break;
 		                    case 'u':
-		                        parse_hex4(p, u);
+		                        if(!parse_hex4(p, u))
+		                            return false;
 		                        if(u >= 0xD800 && u <= 0xDBFF) {
 		                            if(*p++ != '\\')
-		                                throw std::logic_error("PARSE_INVALID_UNICODE_SURROGATE");
+		                                return fail("PARSE_INVALID_UNICODE_SURROGATE", p - 1);
 		                            if(*p++ != 'u')
-		                                throw std::logic_error("PARSE_INVALID_UNICODE_SURROGATE");
-		                            parse_hex4(p, u2);
+		                                return fail("PARSE_INVALID_UNICODE_SURROGATE", p - 1);
+		                            if(!parse_hex4(p, u2))
+		                                return false;
 		                            if(u2 < 0xDC00 || u2 > 0xDFFF)
-		                                throw std::logic_error("PARSE_INVALID_UNICODE_SURROGATE");
+		                                return fail("PARSE_INVALID_UNICODE_SURROGATE", p - 4);
 		                            u = (((u - 0xD800) << 10) | (u2 - 0xDC00)) + 0x10000;
+		                        } else if(u >= 0xDC00 && u <= 0xDFFF && (flags & PARSE_VALIDATE_UTF8)) {
+		                            return fail("PARSE_INVALID_UNICODE_SURROGATE", p - 6);
 		                        }
 		                        parse_encode_utf8(tmp, u);
 		                        break;
 		                    default:
-		                        throw std::logic_error("PARSE_INVALID_STRING_ESCAPE");
+		                        return fail("PARSE_INVALID_STRING_ESCAPE", p - 2);
 		                }
 		            } else if((unsigned char)ch < 0x20) {
-		                throw std::logic_error("PARSE_INVALID_STRING_CHAR");
-		            } else
-		                tmp += ch;
+		                return fail("PARSE_INVALID_STRING_CHAR", p - 1);
+		            } else {
+		                // scan_plain only stops here at non-ASCII bytes under PARSE_VALIDATE_UTF8
+		                int n = utf8_sequence(reinterpret_cast<const unsigned char*>(p - 1));
+		                if(n == 0)
+		                    return fail("PARSE_INVALID_UTF8", p - 1);
+		                tmp.append(p - 1, n);
+		                p += n - 1;
+		            }
 		        }
+		        CCJSON_STAT(stats->string_bytes += p - 1 - cur);
 		        cur = p;
-		        return tmp;
+		        return true;
+    		}
+
+    		// first byte at or after p that needs more than a copy: a quote, a
+    		// backslash, a control character, or a non-ASCII byte when validating.
+    		// Runs 16 bytes at a time while the input end is known.
+    		const char* scan_plain(const char* p) const {
+    			bool validate = flags & PARSE_VALIDATE_UTF8;
+#ifdef __SSE2__
+    			if(end) {
+    				const __m128i quote = _mm_set1_epi8('\"'), backslash = _mm_set1_epi8('\\');
+    				const __m128i ctrl = _mm_set1_epi8(0x1f);
+    				while(end - p >= 16) {
+    					__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    					__m128i stop = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+    												_mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+    					unsigned mask = _mm_movemask_epi8(stop);
+    					if(validate)
+    						mask |= _mm_movemask_epi8(v);   // high bit set: not ASCII
+    					if(mask)
+    						return p + __builtin_ctz(mask);
+    					p += 16;
+    				}
+    			}
+#endif
+    			for(;; ++p) {
+    				unsigned char ch = *p;
+    				if(ch < 0x20 || ch == '\"' || ch == '\\' || (ch >= 0x80 && validate))
+    					return p;
+    			}
+    		}
+    		// length of the well formed UTF-8 sequence at p, 0 when ill formed
+    		// (Unicode 3.9, table 3-7: no overlongs, surrogates or code points past U+10FFFF)
+    		static int utf8_sequence(const unsigned char* p) {
+    			unsigned char c = p[0];
+    			if(c < 0x80)
+    				return 1;
+    			if(c < 0xC2 || c > 0xF4)
+    				return 0;
+    			if(c < 0xE0)
+    				return (p[1] & 0xC0) == 0x80 ? 2 : 0;
+    			unsigned char lo = 0x80, hi = 0xBF;
+    			if(c == 0xE0)
+    				lo = 0xA0;
+    			else if(c == 0xED)
+    				hi = 0x9F;
+    			else if(c == 0xF0)
+    				lo = 0x90;
+    			else if(c == 0xF4)
+    				hi = 0x8F;
+    			if(p[1] < lo || p[1] > hi || (p[2] & 0xC0) != 0x80)
+    				return 0;
+    			if(c < 0xF0)
+    				return 3;
+    			return (p[3] & 0xC0) == 0x80 ? 4 : 0;
     		}
 
-    		void parse_hex4(const char* &p, unsigned &u) {
+    		bool parse_hex4(const char* &p, unsigned &u) {
 		        u = 0;
 		        for(int i=0; i<4; ++i) {
 		            char ch = *p++;
@@ -520,8 +1273,9 @@ namespace json {
 		            else if(ch >= 'a' && ch <= 'f')
 		                u |= ch - ('a' - 10);
 		            else
-		                throw std::logic_error("PARSE_INVALID_UNICODE_HEX");
+		                return fail("PARSE_INVALID_UNICODE_HEX", p - 1);
 		        }
+		        return true;
     		}
 
     		void parse_encode_utf8(std::string& str, unsigned u) const {
@@ -543,66 +1297,63 @@ namespace json {
         		}
     		}
 
-    		Json::Jarray parse_array(int depth) {
+    		bool parse_array(int depth, Json& out) {
     			expect(cur, '[');
     			parse_whitespace();
     			Json::Jarray tmp;
     			if(*cur == ']') {
     				++cur;
-    				return tmp;
+    				out = move(tmp);
+    				return true;
     			}
     			for(;;) {
     				Json tmpVal;
-    				try{
-    					tmpVal = parse_value(depth+1);
-    				} catch(...) {
-    					throw;
-    				}
-    				tmp.push_back(tmpVal);
+    				if(!parse_value(depth+1, tmpVal))
+    					return false;
+    				tmp.push_back(move(tmpVal));
     				parse_whitespace();
     				if(*cur == ',') {
     					++cur;
     					parse_whitespace();
     				} else if(*cur == ']') {
     					++cur;
-    					return tmp;
+    					out = move(tmp);
+    					return true;
     				} else {
-    					throw std::logic_error("PARSE_MISS_COMMA_OR_SQUARE_BRACKET");
+    					return fail("PARSE_MISS_COMMA_OR_SQUARE_BRACKET");
     				}
     			}
     		}
 
-    		Json::Jobject parse_object(int depth) {
+    		bool parse_object(int depth, Json& out) {
     			expect(cur, '{');
     			parse_whitespace();
     			Json::Jobject tmp;
     			string key;
     			if(*cur == '}') {
     				++cur;
-    				return tmp;
+    				out = move(tmp);
+    				return true;
     			}
 
     			for(;;) {
     				if(*cur != '\"')
-    					throw std::logic_error("PARSE_MISS_KEY");
-    				try{
-    					key = parse_string();
-    				} catch(...) {
-    					throw std::logic_error("PARSE_MISS_KEY");
+    					return fail("PARSE_MISS_KEY");
+    				if(!parse_string(key)) {
+    					error = "PARSE_MISS_KEY";
+    					return false;
     				}
 
     				parse_whitespace();
-    				if(*cur++ != ':')
-    					throw std::logic_error("PARSE_MISS_COLON");
+    				if(*cur != ':')
+    					return fail("PARSE_MISS_COLON");
+    				++cur;
     				parse_whitespace();
     				Json tmpVal;
-    				try {
-    					tmpVal = parse_value(depth+1);
-    				} catch(...) {
-    					throw;
-    				}
+    				if(!parse_value(depth+1, tmpVal))
+    					return false;
 
-    				tmp[key] = tmpVal;
+    				tmp[key] = move(tmpVal);
     				key.clear();
     				parse_whitespace();
     				if(*cur == ',') {
@@ -610,29 +1361,2836 @@ namespace json {
     					parse_whitespace();
     				} else if(*cur == '}') {
     					++cur;
-    					return tmp;
+    					out = move(tmp);
+    					return true;
     				} else {
-    					throw std::logic_error("PARSE_MISS_COMMA_OR_CURLY_BRACKET");
+    					return fail("PARSE_MISS_COMMA_OR_CURLY_BRACKET");
     				}
     			}
     		}
 
- 		};
- 	}
+    		// throwing forms for the projection, schema and binding paths
+    		Json parse_value(int depth) {
+    			Json v;
+    			check(parse_value(depth, v));
+    			return v;
+    		}
+    		double parse_double() {
+    			double v = 0;
+    			check(parse_double(v));
+    			return v;
+    		}
+    		string parse_string() {
+    			string v;
+    			check(parse_string(v));
+    			return v;
+    		}
+    		// skips a value, checking it against the parse_value grammar
+    		void skip_value(int depth) {
+    			check(scan_value(depth));
+    		}
+    		// parse_value building nothing, for the parts a projection, schema
+    		// or binding does not keep
+    		bool scan_value(int depth) {
+    			if(depth > max_depth)
+    				return fail("EXCEEDED_MAXIMUM_NESTING_DEPTH");
+        		switch(*cur) {
+            		case 'n': return match_literal("null");
+            		case 't': return match_literal("true");
+            		case 'f': return match_literal("false");
+            		case '\"': return scan_string();
+            		case '[': return scan_array(depth);
+            		case '{': return scan_object(depth);
+            		default: {
+            			const char* p = cur;
+            			if(!scan_finite_number(p))
+            				return false;
+            			cur = p;
+            			return true;
+            		}
+            		case '\0': return fail("PARSE_EXPECT_VALUE");
+        		}
+    		}
+    		bool scan_array(int depth) {
+    			expect(cur, '[');
+    			parse_whitespace();
+    			if(*cur == ']') {
+    				++cur;
+    				return true;
+    			}
+    			for(;;) {
+    				if(!scan_value(depth+1))
+    					return false;
+    				parse_whitespace();
+    				if(*cur == ',') {
+    					++cur;
+    					parse_whitespace();
+    				} else if(*cur == ']') {
+    					++cur;
+    					return true;
+    				} else {
+    					return fail("PARSE_MISS_COMMA_OR_SQUARE_BRACKET");
+    				}
+    			}
+    		}
+    		bool scan_object(int depth) {
+    			expect(cur, '{');
+    			parse_whitespace();
+    			if(*cur == '}') {
+    				++cur;
+    				return true;
+    			}
+    			for(;;) {
+    				if(*cur != '\"')
+    					return fail("PARSE_MISS_KEY");
+    				if(!scan_string()) {
+    					error = "PARSE_MISS_KEY";
+    					return false;
+    				}
+    				parse_whitespace();
+    				if(*cur != ':')
+    					return fail("PARSE_MISS_COLON");
+    				++cur;
+    				parse_whitespace();
+    				if(!scan_value(depth+1))
+    					return false;
+    				parse_whitespace();
+    				if(*cur == ',') {
+    					++cur;
+    					parse_whitespace();
+    				} else if(*cur == '}') {
+    					++cur;
+    					return true;
+    				} else {
+    					return fail("PARSE_MISS_COMMA_OR_CURLY_BRACKET");
+    				}
+    			}
+    		}
+    		// parse_string's checks without decoding
+    		bool scan_string() {
+    			expect(cur, '\"');
+    			const char* p = cur;
+    			unsigned u = 0;
+    			for(;;) {
+    				p = scan_plain(p);
+    				char ch = *p++;
+    				if(ch == '\"')
+    					break;
+    				else if(ch == '\0')
+    					return fail("PARSE_MISS_QUOTATION_MARK", p - 1);
+    				else if(ch == '\\') {
+    					switch(*p++) {
+    						case '\"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+    							break;
+    						case 'u':
+    							if(!parse_hex4(p, u))
+    								return false;
+    							if(u >= 0xD800 && u <= 0xDBFF) {
+    								if(*p++ != '\\')
+    									return fail("PARSE_INVALID_UNICODE_SURROGATE", p - 1);
+    								if(*p++ != 'u')
+    									return fail("PARSE_INVALID_UNICODE_SURROGATE", p - 1);
+    								if(!parse_hex4(p, u))
+    									return false;
+    								if(u < 0xDC00 || u > 0xDFFF)
+    									return fail("PARSE_INVALID_UNICODE_SURROGATE", p - 4);
+    							} else if(u >= 0xDC00 && u <= 0xDFFF && (flags & PARSE_VALIDATE_UTF8)) {
+    								return fail("PARSE_INVALID_UNICODE_SURROGATE", p - 6);
+    							}
+    							break;
+    						default:
+    							return fail("PARSE_INVALID_STRING_ESCAPE", p - 2);
+    					}
+    				} else if((unsigned char)ch < 0x20) {
+    					return fail("PARSE_INVALID_STRING_CHAR", p - 1);
+    				} else {
+    					int n = utf8_sequence(reinterpret_cast<const unsigned char*>(p - 1));
+    					if(n == 0)
+    						return fail("PARSE_INVALID_UTF8", p - 1);
+    					p += n - 1;
+    				}
+    			}
+    			cur = p;
+    			return true;
+    		}
 
- 	void Json::dump(std::string& out) const {
- 		m_ptr->dump(out);
- 	}
+    		// false when the value was skipped
+    		bool parse_projected(int depth, const JProjection::Node& node, Json& out) {
+    			if(node.whole) {
+    				out = parse_value(depth);
+    				return true;
+    			}
+    			if(*cur == '{' && !node.keys.empty()) {
+    				out = parse_object(depth, node);
+    				return true;
+    			}
+    			if(*cur == '[' && !node.indices.empty()) {
+    				out = parse_array(depth, node);
+    				return true;
+    			}
+    			skip_value(depth);
+    			return false;
+    		}
 
- 	Json Json::load(const string& in) {
-    	JParser parser { in.c_str() };
-    	Json result;
-    	try {
-    		result = parser.parse_json();
-    	} catch(...) {
+    		Json::Jarray parse_array(int depth, const JProjection::Node& node) {
+    			if(depth > max_depth)
+    				throw std::logic_error("EXCEEDED_MAXIMUM_NESTING_DEPTH");
+    			expect(cur, '[');
+    			parse_whitespace();
+    			Json::Jarray tmp;
+    			size_t last = node.indices.rbegin()->first;
+    			if(*cur == ']') {
+    				++cur;
+    				return tmp;
+    			}
+    			for(size_t i = 0;; ++i) {
+    				auto iter = node.indices.find(i);
+    				Json tmpVal;
+    				if(iter != node.indices.end())
+    					parse_projected(depth+1, *iter->second, tmpVal);
+    				else
+    					skip_value(depth+1);
+    				if(i <= last)
+    					tmp.push_back(move(tmpVal));
+    				parse_whitespace();
+    				if(*cur == ',') {
+    					++cur;
+    					parse_whitespace();
+    				} else if(*cur == ']') {
+    					++cur;
+    					return tmp;
+    				} else {
+    					throw std::logic_error("PARSE_MISS_COMMA_OR_SQUARE_BRACKET");
+    				}
+    			}
+    		}
+
+    		Json::Jobject parse_object(int depth, const JProjection::Node& node) {
+    			if(depth > max_depth)
+    				throw std::logic_error("EXCEEDED_MAXIMUM_NESTING_DEPTH");
+    			expect(cur, '{');
+    			parse_whitespace();
+    			Json::Jobject tmp;
+    			string key;
+    			if(*cur == '}') {
+    				++cur;
+    				return tmp;
+    			}
+
+    			for(;;) {
+    				if(*cur != '\"')
+    					throw std::logic_error("PARSE_MISS_KEY");
+    				if(!parse_string(key))
+    					throw std::logic_error("PARSE_MISS_KEY");
+
+    				parse_whitespace();
+    				if(*cur++ != ':')
+    					throw std::logic_error("PARSE_MISS_COLON");
+    				parse_whitespace();
+    				auto iter = node.keys.find(key);
+    				Json tmpVal;
+    				if(iter == node.keys.end())
+    					skip_value(depth+1);
+    				else if(parse_projected(depth+1, *iter->second, tmpVal))
+    					tmp[key] = move(tmpVal);
+
+    				key.clear();
+    				parse_whitespace();
+    				if(*cur == ',') {
+    					++cur;
+    					parse_whitespace();
+    				} else if(*cur == '}') {
+    					++cur;
+    					return tmp;
+    				} else {
+    					throw std::logic_error("PARSE_MISS_COMMA_OR_CURLY_BRACKET");
+    				}
+    			}
+    		}
+
+
+    		// schema checks run as soon as the value's type is known
+    		Json parse_json(const JSchema::Node& root) {
+    			parse_whitespace();
+    			Json result = parse_checked(0, root);
+    			parse_whitespace();
+    			if(*cur != '\0') {
+    				throw std::logic_error("PARSE_ROOT_NOT_SINGULAR");
+    			}
+    			return result;
+    		}
+    		static void schema_fail(const char* error) {
+    			if(error)
+    				throw std::logic_error(error);
+    		}
+    		Json parse_checked(int depth, const JSchema::Node& node) {
+    			if(depth > max_depth)
+    				throw std::logic_error("EXCEEDED_MAXIMUM_NESTING_DEPTH");
+    			Json::Jtype t;
+    			switch(*cur) {
+    				case 'n':  t = Json::JNULL;   break;
+    				case 't':
+    				case 'f':  t = Json::JBOOL;   break;
+    				case '\"': t = Json::JSTRING; break;
+    				case '[':  t = Json::JARRAY;  break;
+    				case '{':  t = Json::JOBJECT; break;
+    				case '\0': throw std::logic_error("PARSE_EXPECT_VALUE");
+    				default:   t = Json::JNUMBER; break;
+    			}
+    			schema_fail(schema_check_type(node, t));
+    			Json result;
+    			switch(t) {
+    				case Json::JNUMBER: {
+    					double v = parse_double();
+    					schema_fail(schema_check_number(node, v));
+    					result = v;
+    					break;
+    				}
+    				case Json::JSTRING: {
+    					string v = parse_string();
+    					schema_fail(schema_check_string(node, v));
+    					result = move(v);
+    					break;
+    				}
+    				case Json::JARRAY:  result = parse_array(depth, node);  break;
+    				case Json::JOBJECT: result = parse_object(depth, node); break;
+    				default:            result = parse_value(depth);        break;
+    			}
+    			schema_fail(schema_check_enum(node, result));
+    			return result;
+    		}
+
+    		Json::Jarray parse_array(int depth, const JSchema::Node& node) {
+    			expect(cur, '[');
+    			parse_whitespace();
+    			Json::Jarray tmp;
+    			if(*cur == ']') {
+    				++cur;
+    				schema_fail(node.min_items > 0 ? "SCHEMA_ITEMS_OUT_OF_RANGE" : nullptr);
+    				return tmp;
+    			}
+    			for(;;) {
+    				if(tmp.size() == node.max_items)
+    					throw std::logic_error("SCHEMA_ITEMS_OUT_OF_RANGE");
+    				Json tmpVal = node.items ? parse_checked(depth+1, *node.items) : parse_value(depth+1);
+    				tmp.push_back(move(tmpVal));
+    				parse_whitespace();
+    				if(*cur == ',') {
+    					++cur;
+    					parse_whitespace();
+    				} else if(*cur == ']') {
+    					++cur;
+    					schema_fail(tmp.size() < node.min_items ? "SCHEMA_ITEMS_OUT_OF_RANGE" : nullptr);
+    					return tmp;
+    				} else {
+    					throw std::logic_error("PARSE_MISS_COMMA_OR_SQUARE_BRACKET");
+    				}
+    			}
+    		}
+
+    		Json::Jobject parse_object(int depth, const JSchema::Node& node) {
+    			expect(cur, '{');
+    			parse_whitespace();
+    			Json::Jobject tmp;
+    			string key;
+    			std::vector<bool> found(node.required.size());
+    			size_t missing = node.required.size();
+    			if(*cur == '}') {
+    				++cur;
+    				schema_fail(missing ? "SCHEMA_MISS_REQUIRED" : nullptr);
+    				return tmp;
+    			}
+
+    			for(;;) {
+    				if(*cur != '\"')
+    					throw std::logic_error("PARSE_MISS_KEY");
+    				if(!parse_string(key))
+    					throw std::logic_error("PARSE_MISS_KEY");
+
+    				parse_whitespace();
+    				if(*cur++ != ':')
+    					throw std::logic_error("PARSE_MISS_COLON");
+    				parse_whitespace();
+    				auto iter = node.properties.find(key);
+    				Json tmpVal = iter == node.properties.end() ? parse_value(depth+1)
+    															: parse_checked(depth+1, *iter->second);
+    				auto req = node.required.find(key);
+    				if(req != node.required.end() && !found[req->second]) {
+    					found[req->second] = true;
+    					--missing;
+    				}
+
+    				tmp[key] = move(tmpVal);
+    				key.clear();
+    				parse_whitespace();
+    				if(*cur == ',') {
+    					++cur;
+    					parse_whitespace();
+    				} else if(*cur == '}') {
+    					++cur;
+    					schema_fail(missing ? "SCHEMA_MISS_REQUIRED" : nullptr);
+    					return tmp;
+    				} else {
+    					throw std::logic_error("PARSE_MISS_COMMA_OR_CURLY_BRACKET");
+    				}
+    			}
+    		}
+
+
+ 		};
+
+ 	void Json::dump(std::string& out) const {
+#ifdef CCJSON_STATS
+ 		JDumpScope scope(out);
+#endif
+#ifdef CCJSON_NODE_CACHE
+ 		JCachePass pass;
+ 		m_ptr->refresh();
+#endif
+ 		m_ptr->dump(out);
+ 	}
+
+ 	Json Json::load(const string& in) {
+    	return load(in, PARSE_DEFAULT);
+    }
+
+    Json Json::raw_number(string text) {
+    	// exactly one number, or "1,\"admin\":true" would dump as extra members
+    	JParser parser { text.c_str(), text.c_str() + text.size() };
+    	const char* p = parser.cur;
+    	parser.check(parser.scan_finite_number(p));
+    	if(p != parser.end)
+    		throw std::logic_error("PARSE_INVALID_VALUE");
+    	Json v;
+    	v.m_ptr = make_node<JRawNumber>(move(text));
+    	return v;
+    }
+
+    Json Json::load(const string& in, JParseFlags flags) {
+    	JParser parser { in.c_str(), in.c_str() + in.size(), flags };
+#ifdef CCJSON_STATS
+    	JParseScope scope(parser.stats, in.size());
+#endif
+    	Json result;
+    	parser.check(parser.parse_json(result));
+    	return result;
+    }
+
+    Json Json::load(const string& in, JParseError& error) {
+    	return load(in, PARSE_DEFAULT, error);
+    }
+
+    Json Json::load(const string& in, JParseFlags flags, JParseError& error) {
+    	JParser parser { in.c_str(), in.c_str() + in.size(), flags };
+#ifdef CCJSON_STATS
+    	JParseScope scope(parser.stats, in.size());
+#endif
+    	Json result;
+    	if(parser.parse_json(result)) {
+    		error = JParseError();
+    		return result;
+    	}
+    	error.code = parser.error;
+    	error.offset = parser.error_at - in.c_str();
+    	error.line = 1;
+    	error.column = 1;
+    	for(size_t i = 0; i < error.offset; ++i) {
+    		if(in[i] == '\n') {
+    			++error.line;
+    			error.column = 1;
+    		} else {
+    			++error.column;
+    		}
+    	}
+    	return Json();
+    }
+
+    Json Json::load(const string& in, const JProjection& projection) {
+    	JParser parser { in.c_str(), in.c_str() + in.size() };
+#ifdef CCJSON_STATS
+    	JParseScope scope(parser.stats, in.size());
+#endif
+    	return parser.parse_json(projection.root());
+    }
+
+    Json Json::load(const string& in, const JSchema& schema) {
+    	JParser parser { in.c_str(), in.c_str() + in.size() };
+#ifdef CCJSON_STATS
+    	JParseScope scope(parser.stats, in.size());
+#endif
+    	return parser.parse_json(schema.root());
+    }
+
+    // binding reader
+    Json::Jtype JReader::peek() {
+    	JParser parser { m_cur };
+    	parser.parse_whitespace();
+    	m_cur = parser.cur;
+    	switch(*m_cur) {
+    		case 'n':  return Json::JNULL;
+    		case 't':
+    		case 'f':  return Json::JBOOL;
+    		case '\"': return Json::JSTRING;
+    		case '[':  return Json::JARRAY;
+    		case '{':  return Json::JOBJECT;
+    		case '\0': throw std::logic_error("PARSE_EXPECT_VALUE");
+    		default:   return Json::JNUMBER;
+    	}
+    }
+    void JReader::read_null() {
+    	if(peek() != Json::JNULL)
+    		throw std::runtime_error("NOT_NULL");
+    	JParser parser { m_cur };
+    	parser.check(parser.match_literal("null"));
+    	m_cur = parser.cur;
+    }
+    bool JReader::read_bool() {
+    	if(peek() != Json::JBOOL)
+    		throw std::runtime_error("NOT_BOOL");
+    	bool v = *m_cur == 't';
+    	JParser parser { m_cur };
+    	parser.check(parser.match_literal(v ? "true" : "false"));
+    	m_cur = parser.cur;
+    	return v;
+    }
+    double JReader::read_number() {
+    	if(peek() != Json::JNUMBER)
+    		throw std::runtime_error("NOT_NUMBER");
+    	JParser parser { m_cur };
+    	double v = parser.parse_double();
+    	m_cur = parser.cur;
+    	return v;
+    }
+    namespace {
+    	bool integer_lexeme(const char* p, const char* end) {
+    		return std::find_if(p, end, [](char ch) { return ch == '.' || ch == 'e' || ch == 'E'; }) == end;
+    	}
+    	// fractions and exponents still make an integer when whole, e.g. 4e15
+    	double whole_number(double v) {
+    		if(v != std::floor(v))
+    			throw std::logic_error("PARSE_NUMBER_NOT_INTEGER");
+    		return v;
+    	}
+    }
+    int64_t JReader::read_int64(int64_t lo, int64_t hi) {
+    	peek();
+    	const char* lexeme = m_cur;
+    	double v = read_number();
+    	int64_t i;
+    	if(integer_lexeme(lexeme, m_cur)) {
+    		errno = 0;
+    		long long parsed = strtoll(lexeme, nullptr, 10);
+    		if(errno == ERANGE)
+    			throw std::logic_error("PARSE_NUMBER_OUT_OF_RANGE");
+    		i = parsed;
+    	} else {
+    		if(!(whole_number(v) >= -9223372036854775808.0 && v < 9223372036854775808.0))
+    			throw std::logic_error("PARSE_NUMBER_OUT_OF_RANGE");
+    		i = static_cast<int64_t>(v);
+    	}
+    	if(i < lo || i > hi)
+    		throw std::logic_error("PARSE_NUMBER_OUT_OF_RANGE");
+    	return i;
+    }
+    uint64_t JReader::read_uint64(uint64_t hi) {
+    	peek();
+    	const char* lexeme = m_cur;
+    	double v = read_number();
+    	uint64_t u;
+    	if(integer_lexeme(lexeme, m_cur)) {
+    		if(*lexeme == '-') {                       // strtoull would wrap it
+    			if(std::find_if(lexeme + 1, m_cur, [](char ch) { return ch != '0'; }) != m_cur)
+    				throw std::logic_error("PARSE_NUMBER_OUT_OF_RANGE");
+    			return 0;
+    		}
+    		errno = 0;
+    		unsigned long long parsed = strtoull(lexeme, nullptr, 10);
+    		if(errno == ERANGE)
+    			throw std::logic_error("PARSE_NUMBER_OUT_OF_RANGE");
+    		u = parsed;
+    	} else {
+    		if(!(whole_number(v) >= 0 && v < 18446744073709551616.0))
+    			throw std::logic_error("PARSE_NUMBER_OUT_OF_RANGE");
+    		u = static_cast<uint64_t>(v);
+    	}
+    	if(u > hi)
+    		throw std::logic_error("PARSE_NUMBER_OUT_OF_RANGE");
+    	return u;
+    }
+    void JReader::read_string(string& out) {
+    	if(peek() != Json::JSTRING)
+    		throw std::runtime_error("NOT_STRING");
+    	JParser parser { m_cur };
+    	out = parser.parse_string();
+    	m_cur = parser.cur;
+    }
+    Json JReader::read_value() {
+    	peek();
+    	JParser parser { m_cur };
+    	Json v = parser.parse_value(m_depth);
+    	m_cur = parser.cur;
+    	return v;
+    }
+    void JReader::skip_value() {
+    	peek();
+    	JParser parser { m_cur };
+    	parser.skip_value(m_depth);
+    	m_cur = parser.cur;
+    }
+
+    void JReader::begin_array() {
+    	if(peek() != Json::JARRAY)
+    		throw std::runtime_error("NOT_ARRAY");
+    	if(++m_depth > max_depth)
+    		throw std::logic_error("EXCEEDED_MAXIMUM_NESTING_DEPTH");
+    	++m_cur;
+    	m_first = true;
+    }
+    bool JReader::next_element() {
+    	return next(']', "PARSE_MISS_COMMA_OR_SQUARE_BRACKET");
+    }
+    void JReader::begin_object() {
+    	if(peek() != Json::JOBJECT)
+    		throw std::runtime_error("NOT_OBJECT");
+    	if(++m_depth > max_depth)
+    		throw std::logic_error("EXCEEDED_MAXIMUM_NESTING_DEPTH");
+    	++m_cur;
+    	m_first = true;
+    }
+    bool JReader::next_member(string& key) {
+    	if(!next('}', "PARSE_MISS_COMMA_OR_CURLY_BRACKET"))
+    		return false;
+    	JParser parser { m_cur };
+    	parser.parse_whitespace();
+    	if(*parser.cur != '\"')
+    		throw std::logic_error("PARSE_MISS_KEY");
+    	if(!parser.parse_string(key))
+    		throw std::logic_error("PARSE_MISS_KEY");
+    	parser.parse_whitespace();
+    	if(*parser.cur++ != ':')
+    		throw std::logic_error("PARSE_MISS_COLON");
+    	parser.parse_whitespace();
+    	m_cur = parser.cur;
+    	return true;
+    }
+    bool JReader::next(char close, const char* error) {
+    	JParser parser { m_cur };
+    	parser.parse_whitespace();
+    	m_cur = parser.cur;
+    	if(m_first) {
+    		m_first = false;
+    	} else if(*m_cur == ',') {
+    		++m_cur;
+    		return true;
+    	} else if(*m_cur != close) {
+    		throw std::logic_error(error);
+    	}
+    	if(*m_cur == close) {
+    		++m_cur;
+    		--m_depth;
+    		return false;
+    	}
+    	return true;
+    }
+
+    void JReader::finish() {
+    	JParser parser { m_cur };
+    	parser.parse_whitespace();
+    	if(*parser.cur != '\0')
+    		throw std::logic_error("PARSE_ROOT_NOT_SINGULAR");
+    }
+
+    // streaming writer
+    JWriter::JWriter(string& out)
+    	: m_sink(nullptr), m_user(nullptr), m_limit(0), m_out(out), m_first(true), m_after_key(false), m_done(false) {}
+
+    JWriter::JWriter(Sink sink, void* user, size_t buffer_size)
+    	: m_sink(sink), m_user(user), m_limit(buffer_size), m_out(m_buffer), m_first(true), m_after_key(false), m_done(false) {
+    	m_buffer.reserve(buffer_size + 64);
+    }
+
+    JWriter::~JWriter() {
+    	flush();
+    }
+
+    void JWriter::flush() {
+    	if(m_sink && !m_buffer.empty()) {
+    		m_sink(m_buffer.data(), m_buffer.size(), m_user);
+    		m_buffer.clear();
+    	}
+    }
+
+    // before a value: the comma, and the checks that a value may go here
+    void JWriter::separate() {
+    	if(m_after_key) {
+    		m_after_key = false;
+    		return;
+    	}
+    	assert(m_open.empty() ? !m_done : m_open.back() == '[');   // object members need a key first
+    	if(!m_first)
+    		m_out += ',';
+    	m_first = false;
+    }
+
+    void JWriter::wrote() {
+    	if(m_open.empty())
+    		m_done = true;
+    	if(m_sink && m_buffer.size() >= m_limit)
+    		flush();
+    }
+
+    JWriter& JWriter::begin_object() {
+    	separate();
+    	m_out += '{';
+    	m_open += '{';
+    	m_first = true;
+    	return *this;
+    }
+    JWriter& JWriter::end_object() {
+    	assert(!m_open.empty() && m_open.back() == '{' && !m_after_key);
+    	m_out += '}';
+    	m_open.pop_back();
+    	m_first = false;
+    	wrote();
+    	return *this;
+    }
+    JWriter& JWriter::begin_array() {
+    	separate();
+    	m_out += '[';
+    	m_open += '[';
+    	m_first = true;
+    	return *this;
+    }
+    JWriter& JWriter::end_array() {
+    	assert(!m_open.empty() && m_open.back() == '[');
+    	m_out += ']';
+    	m_open.pop_back();
+    	m_first = false;
+    	wrote();
+    	return *this;
+    }
+
+    JWriter& JWriter::key(const char* name, size_t len) {
+    	assert(!m_open.empty() && m_open.back() == '{' && !m_after_key);
+    	if(!m_first)
+    		m_out += ',';
+    	m_first = false;
+    	dump_string(name, len, m_out);
+    	m_out += ':';
+    	m_after_key = true;
+    	return *this;
+    }
+    JWriter& JWriter::key(const char* name) {
+    	return key(name, strlen(name));
+    }
+
+    JWriter& JWriter::null() {
+    	separate();
+    	m_out += "null";
+    	wrote();
+    	return *this;
+    }
+    JWriter& JWriter::value(bool v) {
+    	separate();
+    	m_out += v ? "true" : "false";
+    	wrote();
+    	return *this;
+    }
+    JWriter& JWriter::value(double v) {
+    	separate();
+    	dump_number(v, m_out);
+    	wrote();
+    	return *this;
+    }
+    JWriter& JWriter::value(int64_t v) {
+    	separate();
+    	dump_int64(v, m_out);
+    	wrote();
+    	return *this;
+    }
+    JWriter& JWriter::value(uint64_t v) {
+    	separate();
+    	dump_uint64(v, m_out);
+    	wrote();
+    	return *this;
+    }
+    JWriter& JWriter::value(const char* v, size_t len) {
+    	separate();
+    	dump_string(v, len, m_out);
+    	wrote();
+    	return *this;
+    }
+    JWriter& JWriter::value(const char* v) {
+    	return value(v, strlen(v));
+    }
+    // containers go through the writer so a sink sees bounded chunks
+    JWriter& JWriter::value(const Json& v) {
+    	switch(v.get_type()) {
+    		case Json::JARRAY:
+    			begin_array();
+    			for(auto& e : v.get_array())
+    				value(e);
+    			return end_array();
+    		case Json::JOBJECT:
+    			begin_object();
+    			for(auto& m : v.get_object())
+    				key(m.first).value(m.second);
+    			return end_object();
+    		default:
+    			separate();
+    			v.dump(m_out);
+    			wrote();
+    			return *this;
+    	}
+    }
+
+    // JSON Pointer
+    const Json::Jarray* Json::array_ptr()   const { return is_array()  ? &m_ptr->get_array()  : nullptr; }
+    const Json::Jobject* Json::object_ptr() const { return is_object() ? &m_ptr->get_object() : nullptr; }
+    Json::Jarray* Json::array_ptr() {
+    	m_ptr->touch();
+    	return const_cast<Jarray*>(static_cast<const Json*>(this)->array_ptr());
+    }
+    Json::Jobject* Json::object_ptr() {
+    	m_ptr->touch();
+    	return const_cast<Jobject*>(static_cast<const Json*>(this)->object_ptr());
+    }
+
+    JPointer::JPointer(const string& path) {
+    	if(path.empty())
+    		return;
+    	if(path[0] != '/')
+    		throw std::logic_error("POINTER_MISS_SLASH");
+    	size_t pos = 1;
+    	for(;;) {
+    		size_t next = path.find('/', pos);
+    		if(next == string::npos)
+    			next = path.size();
+    		Token t { string(), npos };
+    		t.key.reserve(next - pos);
+    		for(size_t i = pos; i < next; ++i) {
+    			if(path[i] != '~') {
+    				t.key += path[i];
+    			} else if(i + 1 < next && path[i+1] == '0') {
+    				t.key += '~';
+    				++i;
+    			} else if(i + 1 < next && path[i+1] == '1') {
+    				t.key += '/';
+    				++i;
+    			} else {
+    				throw std::logic_error("POINTER_INVALID_ESCAPE");
+    			}
+    		}
+    		if(t.key == "-") {
+    			t.index = end;
+    		} else if(!t.key.empty() && t.key.size() < 20 && (t.key == "0" || t.key[0] != '0')
+    				  && t.key.find_first_not_of("0123456789") == string::npos) {
+    			t.index = std::stoull(t.key);
+    		}
+    		m_tokens.push_back(move(t));
+    		if(next == path.size())
+    			break;
+    		pos = next + 1;
+    	}
+    }
+
+    string JPointer::to_string() const {
+    	string out;
+    	for(auto& t : m_tokens) {
+    		out += '/';
+    		for(char ch : t.key) {
+    			if(ch == '~')
+    				out += "~0";
+    			else if(ch == '/')
+    				out += "~1";
+    			else
+    				out += ch;
+    		}
+    	}
+    	return out;
+    }
+
+    const Json* JPointer::step(const Json& v, const Token& t) noexcept {
+    	if(const Json::Jobject* o = v.object_ptr()) {
+    		auto iter = o->find(t.key);
+    		return iter == o->end() ? nullptr : &iter->second;
+    	}
+    	if(const Json::Jarray* a = v.array_ptr()) {
+    		return t.index < a->size() ? &(*a)[t.index] : nullptr;
+    	}
+    	return nullptr;
+    }
+    Json* JPointer::step(Json& v, const Token& t) noexcept {
+    	if(Json::Jobject* o = v.object_ptr()) {
+    		auto iter = o->find(t.key);
+    		return iter == o->end() ? nullptr : &iter->second;
+    	}
+    	if(Json::Jarray* a = v.array_ptr()) {
+    		return t.index < a->size() ? &(*a)[t.index] : nullptr;
+    	}
+    	return nullptr;
+    }
+
+    const Json* JPointer::find(const Json& doc) const noexcept {
+    	const Json* v = &doc;
+    	for(size_t i = 0; v && i < m_tokens.size(); ++i)
+    		v = step(*v, m_tokens[i]);
+    	return v;
+    }
+    Json* JPointer::find(Json& doc) const noexcept {
+    	return const_cast<Json*>(find(static_cast<const Json&>(doc)));
+    }
+
+    const Json& JPointer::get(const Json& doc) const {
+    	const Json* v = find(doc);
+    	if(!v)
+    		throw std::out_of_range(to_string());
+    	return *v;
+    }
+    Json& JPointer::get(Json& doc) const {
+    	Json* v = find(doc);
+    	if(!v)
+    		throw std::out_of_range(to_string());
+    	return *v;
+    }
+
+    Json* JPointer::parent(Json& doc) const {
+    	Json* v = &doc;
+    	v->detach();
+    	for(size_t i = 0; i + 1 < m_tokens.size(); ++i) {
+    		v = step(*v, m_tokens[i]);
+    		if(!v)
+    			throw std::out_of_range(to_string());
+    		v->detach();
+    	}
+    	return v;
+    }
+
+    void JPointer::set(Json& doc, Json value) const {
+    	if(m_tokens.empty()) {
+    		doc = move(value);
+    		return;
+    	}
+    	Json* p = parent(doc);
+    	const Token& t = m_tokens.back();
+    	if(Json::Jobject* o = p->object_ptr()) {
+    		(*o)[t.key] = move(value);
+    	} else if(Json::Jarray* a = p->array_ptr()) {
+    		if(t.index == end || t.index == a->size())
+    			a->push_back(move(value));
+    		else if(t.index < a->size())
+    			(*a)[t.index] = move(value);
+    		else
+    			throw std::out_of_range(to_string());
+    	} else {
+    		throw std::out_of_range(to_string());
+    	}
+    }
+
+    void JPointer::add(Json& doc, Json value) const {
+    	if(m_tokens.empty()) {
+    		doc = move(value);
+    		return;
+    	}
+    	Json* p = parent(doc);
+    	const Token& t = m_tokens.back();
+    	if(Json::Jarray* a = p->array_ptr()) {
+    		if(t.index == end)
+    			a->push_back(move(value));
+    		else if(t.index <= a->size())
+    			a->insert(a->begin() + t.index, move(value));
+    		else
+    			throw std::out_of_range(to_string());
+    	} else {
+    		set(doc, move(value));
+    	}
+    }
+
+    Json JPointer::remove(Json& doc) const {
+    	Json removed;
+    	if(m_tokens.empty()) {
+    		std::swap(removed, doc);
+    		return removed;
+    	}
+    	Json* p = parent(doc);
+    	const Token& t = m_tokens.back();
+    	if(Json::Jobject* o = p->object_ptr()) {
+    		auto iter = o->find(t.key);
+    		if(iter == o->end())
+    			throw std::out_of_range(to_string());
+    		removed = move(iter->second);
+    		o->erase(iter);
+    	} else if(Json::Jarray* a = p->array_ptr()) {
+    		if(t.index >= a->size())
+    			throw std::out_of_range(to_string());
+    		removed = move((*a)[t.index]);
+    		a->erase(a->begin() + t.index);
+    	} else {
+    		throw std::out_of_range(to_string());
+    	}
+    	return removed;
+    }
+
+    // JSONPath
+    struct JPath::Step {
+    	enum Kind { NAME, WILDCARD, INDEX, SLICE, FILTER };
+    	enum Op { EXISTS, EQ, NE, LT, LE, GT, GE };
+
+    	Kind kind;
+    	bool descend;                 // ".." before the selector
+    	string name;
+    	long long start, stop, step;  // INDEX uses start
+    	bool has_start, has_stop;
+    	JPointer field;               // FILTER, relative to @
+    	Op op;
+    	Json literal;
+
+    	bool matches(const Json& v) const {
+    		const Json* f = field.find(v);
+    		if(!f)
+    			return false;
+    		switch(op) {
+    			case EXISTS: return true;
+    			case EQ: return *f == literal;
+    			case NE: return *f != literal;
+    			default: break;
+    		}
+    		Json::Jtype type = f->get_type();
+    		if(type != literal.get_type() || (type != Json::JNUMBER && type != Json::JSTRING))
+    			return false;
+    		switch(op) {
+    			case LT: return *f < literal;
+    			case LE: return *f <= literal;
+    			case GT: return *f > literal;
+    			default: return *f >= literal;
+    		}
+    	}
+    };
+
+    namespace {
+    	struct JPathCompiler final {
+    		const string& expr;
+    		size_t i;
+
+    		[[noreturn]] void fail() const {
+    			throw std::logic_error("PATH_INVALID_SYNTAX");
+    		}
+    		bool more() const {
+    			return i < expr.size();
+    		}
+    		bool accept(char ch) {
+    			if(more() && expr[i] == ch) {
+    				++i;
+    				return true;
+    			}
+    			return false;
+    		}
+    		void require(char ch) {
+    			if(!accept(ch))
+    				fail();
+    		}
+    		void skip_spaces() {
+    			while(accept(' '))
+    				;
+    		}
+    		static bool name_char(char ch) {
+    			return (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9')
+    				|| ch == '_' || ch == '-' || ch == '$' || static_cast<unsigned char>(ch) >= 0x80;
+    		}
+    		string name() {
+    			size_t begin = i;
+    			while(more() && name_char(expr[i]))
+    				++i;
+    			if(i == begin)
+    				fail();
+    			return expr.substr(begin, i - begin);
+    		}
+    		bool at_quote() const {
+    			return more() && (expr[i] == '\'' || expr[i] == '\"');
+    		}
+    		// 'text' or "text", a backslash takes the next character as is
+    		string quoted() {
+    			char quote = expr[i++];
+    			string out;
+    			for(;;) {
+    				if(!more())
+    					fail();
+    				char ch = expr[i++];
+    				if(ch == quote)
+    					return out;
+    				if(ch == '\\') {
+    					if(!more())
+    						fail();
+    					ch = expr[i++];
+    				}
+    				out += ch;
+    			}
+    		}
+    		bool integer(long long& value) {
+    			size_t begin = i;
+    			accept('-');
+    			size_t digits = i;
+    			while(more() && expr[i] >= '0' && expr[i] <= '9')
+    				++i;
+    			if(i == digits || i - digits > 18) {
+    				i = begin;
+    				return false;
+    			}
+    			value = std::stoll(expr.substr(begin, i - begin));
+    			return true;
+    		}
+    		Json literal() {
+    			if(at_quote())
+    				return Json(quoted());
+    			size_t begin = i;
+    			while(more() && (name_char(expr[i]) || expr[i] == '.' || expr[i] == '+'))
+    				++i;
+    			JParseError error;
+    			Json value = Json::load(expr.substr(begin, i - begin), error);
+    			if(error || value.is_array() || value.is_object())
+    				throw std::logic_error("PATH_INVALID_FILTER");
+    			return value;
+    		}
+    		static void append_token(string& pointer, const string& key) {
+    			pointer += '/';
+    			for(char ch : key) {
+    				if(ch == '~')
+    					pointer += "~0";
+    				else if(ch == '/')
+    					pointer += "~1";
+    				else
+    					pointer += ch;
+    			}
+    		}
+    		void filter(JPath::Step& step) {
+    			step.kind = JPath::Step::FILTER;
+    			require('(');
+    			skip_spaces();
+    			require('@');
+    			string pointer;
+    			for(;;) {
+    				long long index;
+    				if(accept('.')) {
+    					append_token(pointer, name());
+    				} else if(accept('[')) {
+    					if(at_quote())
+    						append_token(pointer, quoted());
+    					else if(integer(index) && index >= 0)
+    						append_token(pointer, std::to_string(index));
+    					else
+    						throw std::logic_error("PATH_INVALID_FILTER");
+    					require(']');
+    				} else {
+    					break;
+    				}
+    			}
+    			step.field = JPointer(pointer);
+    			skip_spaces();
+    			static const struct { const char* text; JPath::Step::Op op; } ops[] = {
+    				{ "==", JPath::Step::EQ }, { "!=", JPath::Step::NE }, { "<=", JPath::Step::LE },
+    				{ ">=", JPath::Step::GE }, { "<", JPath::Step::LT }, { ">", JPath::Step::GT },
+    			};
+    			step.op = JPath::Step::EXISTS;
+    			for(auto& o : ops) {
+    				if(expr.compare(i, strlen(o.text), o.text) == 0) {
+    					i += strlen(o.text);
+    					step.op = o.op;
+    					skip_spaces();
+    					step.literal = literal();
+    					skip_spaces();
+    					break;
+    				}
+    			}
+    			require(')');
+    		}
+    		// after '[', through the closing ']'
+    		void bracket(JPath::Step& step) {
+    			skip_spaces();
+    			if(accept('*')) {
+    				step.kind = JPath::Step::WILDCARD;
+    			} else if(at_quote()) {
+    				step.kind = JPath::Step::NAME;
+    				step.name = quoted();
+    			} else if(accept('?')) {
+    				filter(step);
+    			} else {
+    				step.has_start = integer(step.start);
+    				skip_spaces();
+    				if(accept(':')) {
+    					step.kind = JPath::Step::SLICE;
+    					skip_spaces();
+    					step.has_stop = integer(step.stop);
+    					skip_spaces();
+    					step.step = 1;
+    					if(accept(':')) {
+    						skip_spaces();
+    						if(integer(step.step) && step.step == 0)
+    							throw std::logic_error("PATH_INVALID_SLICE");
+    					}
+    				} else if(step.has_start) {
+    					step.kind = JPath::Step::INDEX;
+    				} else {
+    					fail();
+    				}
+    			}
+    			skip_spaces();
+    			require(']');
+    		}
+    		std::vector<JPath::Step> compile() {
+    			std::vector<JPath::Step> steps;
+    			skip_spaces();
+    			if(!accept('$'))
+    				throw std::logic_error("PATH_MISS_ROOT");
+    			while(more()) {
+    				JPath::Step step = JPath::Step();
+    				if(accept('.')) {
+    					step.descend = accept('.');
+    					if(accept('*')) {
+    						step.kind = JPath::Step::WILDCARD;
+    					} else if(step.descend && accept('[')) {
+    						bracket(step);
+    					} else {
+    						step.kind = JPath::Step::NAME;
+    						step.name = name();
+    					}
+    				} else if(accept('[')) {
+    					bracket(step);
+    				} else {
+    					fail();
+    				}
+    				steps.push_back(move(step));
+    			}
+    			return steps;
+    		}
+    	};
+    }
+
+    JPath::JPath(const string& expr) {
+    	JPathCompiler compiler { expr, 0 };
+    	m_steps = std::make_shared<const std::vector<Step>>(compiler.compile());
+    }
+
+    void JPath::find(const Json& doc, std::vector<const Json*>& out) const {
+    	walk(doc, 0, out);
+    }
+
+    void JPath::walk(const Json& v, size_t i, std::vector<const Json*>& out) const {
+    	const std::vector<Step>& steps = *m_steps;
+    	if(i == steps.size()) {
+    		out.push_back(&v);
+    		return;
+    	}
+    	select(v, i, out);
+    	if(steps[i].descend) {
+    		if(const Json::Jarray* a = v.array_ptr()) {
+    			for(auto& e : *a)
+    				walk(e, i, out);
+    		} else if(const Json::Jobject* o = v.object_ptr()) {
+    			for(auto& m : *o)
+    				walk(m.second, i, out);
+    		}
+    	}
+    }
+
+    void JPath::select(const Json& v, size_t i, std::vector<const Json*>& out) const {
+    	const Step& s = (*m_steps)[i];
+    	const Json::Jarray* a = v.array_ptr();
+    	const Json::Jobject* o = v.object_ptr();
+    	long long n = a ? static_cast<long long>(a->size()) : 0;
+    	switch(s.kind) {
+    		case Step::NAME:
+    			if(o) {
+    				auto iter = o->find(s.name);
+    				if(iter != o->end())
+    					walk(iter->second, i + 1, out);
+    			}
+    			break;
+    		case Step::WILDCARD:
+    		case Step::FILTER:
+    			if(a) {
+    				for(auto& e : *a)
+    					if(s.kind == Step::WILDCARD || s.matches(e))
+    						walk(e, i + 1, out);
+    			} else if(o) {
+    				for(auto& m : *o)
+    					if(s.kind == Step::WILDCARD || s.matches(m.second))
+    						walk(m.second, i + 1, out);
+    			}
+    			break;
+    		case Step::INDEX: {
+    			long long k = s.start < 0 ? s.start + n : s.start;
+    			if(a && k >= 0 && k < n)
+    				walk((*a)[static_cast<size_t>(k)], i + 1, out);
+    			break;
+    		}
+    		case Step::SLICE: {
+    			if(!a)
+    				break;
+    			// Python slice bounds
+    			auto bound = [n](long long k, long long lo, long long hi) {
+    				if(k < 0)
+    					k += n;
+    				return std::min(std::max(k, lo), hi);
+    			};
+    			if(s.step > 0) {
+    				long long k = s.has_start ? bound(s.start, 0, n) : 0;
+    				long long stop = s.has_stop ? bound(s.stop, 0, n) : n;
+    				for(; k < stop; k += s.step)
+    					walk((*a)[static_cast<size_t>(k)], i + 1, out);
+    			} else {
+    				long long k = s.has_start ? bound(s.start, -1, n - 1) : n - 1;
+    				long long stop = s.has_stop ? bound(s.stop, -1, n - 1) : -1;
+    				for(; k > stop; k += s.step)
+    					walk((*a)[static_cast<size_t>(k)], i + 1, out);
+    			}
+    			break;
+    		}
+    	}
+    }
+
+    void JPath::find_all(const std::vector<Json>& docs, std::vector<std::vector<const Json*>>& results,
+    					 unsigned threads) const {
+    	results.resize(docs.size());
+    	auto run = [&](size_t begin, size_t end) {
+    		for(size_t k = begin; k < end; ++k) {
+    			results[k].clear();
+    			walk(docs[k], 0, results[k]);
+    		}
+    	};
+    	if(threads == 0)
+    		threads = std::max(1u, std::thread::hardware_concurrency());
+    	size_t per = (docs.size() + threads - 1) / threads;
+    	if(threads == 1 || per < 2) {
+    		run(0, docs.size());
+    		return;
+    	}
+    	std::vector<std::thread> workers;
+    	for(size_t begin = per; begin < docs.size(); begin += per)
+    		workers.emplace_back(run, begin, std::min(begin + per, docs.size()));
+    	run(0, per);
+    	for(auto& t : workers)
+    		t.join();
+    }
+
+    // columnar extraction
+    JColumns::JColumns(const std::vector<std::pair<string, Kind>>& fields) {
+    	for(auto& f : fields) {
+    		Column c;
+    		c.name = f.first;
+    		c.kind = f.second;
+    		c.offsets.push_back(0);
+    		m_columns.push_back(move(c));
+    	}
+    }
+
+    void JColumns::clear() {
+    	for(auto& c : m_columns) {
+    		c.doubles.clear();
+    		c.ints.clear();
+    		c.offsets.assign(1, 0);
+    		c.blob.clear();
+    		c.validity.clear();
+    	}
+    	m_rows = 0;
+    }
+
+    const JColumns::Column* JColumns::find(const string& name) const {
+    	for(auto& c : m_columns)
+    		if(c.name == name)
+    			return &c;
+    	return nullptr;
+    }
+    JColumns::Column* JColumns::column(const string& name) {
+    	return const_cast<Column*>(find(name));
+    }
+
+    // a row of nulls, filled in by the setters
+    void JColumns::add_row() {
+    	for(auto& c : m_columns) {
+    		switch(c.kind) {
+    			case DOUBLE: c.doubles.push_back(0); break;
+    			case INT64:  c.ints.push_back(0); break;
+    			case STRING: c.offsets.push_back(c.blob.size()); break;
+    		}
+    		if(m_rows % 64 == 0)
+    			c.validity.push_back(0);
+    	}
+    	++m_rows;
+    }
+
+    void JColumns::set_valid(Column& c, bool valid) {
+    	size_t row = m_rows - 1;
+    	uint64_t bit = uint64_t(1) << (row % 64);
+    	if(valid)
+    		c.validity[row / 64] |= bit;
+    	else
+    		c.validity[row / 64] &= ~bit;
+    }
+
+    // a repeated member replaces the earlier value, as in a parsed Jobject
+    void JColumns::set_null(Column& c) {
+    	size_t row = m_rows - 1;
+    	switch(c.kind) {
+    		case DOUBLE: c.doubles[row] = 0; break;
+    		case INT64:  c.ints[row] = 0; break;
+    		case STRING:
+    			c.blob.resize(c.offsets[row]);
+    			c.offsets[row + 1] = c.blob.size();
+    			break;
+    	}
+    	set_valid(c, false);
+    }
+
+    // lexeme is the number's text when parsing, so INT64 columns keep
+    // integers beyond 2^53 exact
+    void JColumns::set_number(Column& c, double v, const char* lexeme, size_t len) {
+    	size_t row = m_rows - 1;
+    	if(c.kind == DOUBLE) {
+    		c.doubles[row] = v;
+    		set_valid(c, true);
+    		return;
+    	}
+    	if(c.kind == INT64) {
+    		if(lexeme && std::find_if(lexeme, lexeme + len, [](char ch) {
+    				return ch == '.' || ch == 'e' || ch == 'E'; }) == lexeme + len) {
+    			errno = 0;
+    			long long i = strtoll(lexeme, nullptr, 10);
+    			if(errno != ERANGE) {
+    				c.ints[row] = i;
+    				set_valid(c, true);
+    				return;
+    			}
+    		} else if(v == std::floor(v) && v >= -9223372036854775808.0 && v < 9223372036854775808.0) {
+    			c.ints[row] = static_cast<int64_t>(v);
+    			set_valid(c, true);
+    			return;
+    		}
+    	}
+    	set_null(c);
+    }
+
+    void JColumns::set_string(Column& c, const char* v, size_t len) {
+    	if(c.kind != STRING) {
+    		set_null(c);
+    		return;
+    	}
+    	size_t row = m_rows - 1;
+    	c.blob.resize(c.offsets[row]);
+    	c.blob.append(v, len);
+    	c.offsets[row + 1] = c.blob.size();
+    	set_valid(c, true);
+    }
+
+    void JColumns::append(const Json& rows) {
+    	for(auto& e : rows.get_array()) {
+    		add_row();
+    		const Json::Jobject* o = e.object_ptr();
+    		if(!o)
+    			continue;
+    		for(auto& c : m_columns) {
+    			auto iter = o->find(c.name);
+    			if(iter == o->end())
+    				continue;
+    			const Json& v = iter->second;
+    			if(v.is_number())
+    				set_number(c, v.get_number(), nullptr, 0);
+    			else if(v.is_string())
+    				set_string(c, v.get_string().data(), v.get_string().size());
+    		}
+    	}
+    }
+
+    void JColumns::load(const string& text) {
+    	JParser parser { text.c_str(), text.c_str() + text.size() };
+    	parser.parse_whitespace();
+    	if(*parser.cur != '[')
+    		throw std::runtime_error("NOT_ARRAY");
+    	++parser.cur;
+    	parser.parse_whitespace();
+    	string key, value;
+    	bool more_rows = *parser.cur != ']';
+    	if(!more_rows)
+    		++parser.cur;
+    	while(more_rows) {
+    		add_row();
+    		if(*parser.cur != '{') {
+    			parser.skip_value(1);
+    		} else {
+    			++parser.cur;
+    			parser.parse_whitespace();
+    			bool more_members = *parser.cur != '}';
+    			if(!more_members)
+    				++parser.cur;
+    			while(more_members) {
+    				if(*parser.cur != '\"' || !parser.parse_string(key))
+    					throw std::logic_error("PARSE_MISS_KEY");
+    				parser.parse_whitespace();
+    				if(*parser.cur != ':')
+    					throw std::logic_error("PARSE_MISS_COLON");
+    				++parser.cur;
+    				parser.parse_whitespace();
+    				Column* c = column(key);
+    				if(!c) {
+    					parser.skip_value(2);
+    				} else if(*parser.cur == '\"') {
+    					parser.check(parser.parse_string(value));
+    					set_string(*c, value.data(), value.size());
+    				} else if(*parser.cur == '-' || (*parser.cur >= '0' && *parser.cur <= '9')) {
+    					const char* lexeme = parser.cur;
+    					double v;
+    					parser.check(parser.parse_double(v));
+    					set_number(*c, v, lexeme, parser.cur - lexeme);
+    				} else {
+    					Json other;
+    					parser.check(parser.parse_value(2, other));
+    					set_null(*c);
+    				}
+    				parser.parse_whitespace();
+    				if(*parser.cur == ',') {
+    					++parser.cur;
+    					parser.parse_whitespace();
+    				} else if(*parser.cur == '}') {
+    					++parser.cur;
+    					more_members = false;
+    				} else {
+    					throw std::logic_error("PARSE_MISS_COMMA_OR_CURLY_BRACKET");
+    				}
+    			}
+    		}
+    		parser.parse_whitespace();
+    		if(*parser.cur == ',') {
+    			++parser.cur;
+    			parser.parse_whitespace();
+    		} else if(*parser.cur == ']') {
+    			++parser.cur;
+    			more_rows = false;
+    		} else {
+    			throw std::logic_error("PARSE_MISS_COMMA_OR_SQUARE_BRACKET");
+    		}
+    	}
+    	parser.parse_whitespace();
+    	if(*parser.cur != '\0')
+    		throw std::logic_error("PARSE_ROOT_NOT_SINGULAR");
+    }
+
+    // parse cache
+    struct JParseCache::State {
+    	struct Entry {
+    		size_t hash;
+    		string text;
+    		std::shared_ptr<const JSnapshot> doc;
+    		size_t cost;
+    	};
+
+    	mutable std::mutex mutex;
+    	std::list<Entry> lru;                                   // most recent first
+    	std::unordered_map<size_t, std::list<Entry>::iterator> index;
+    	size_t max_bytes;
+    	Stats stats;
+    };
+
+    JParseCache::JParseCache(size_t max_bytes) : m_state(new State()) {
+    	m_state->max_bytes = max_bytes;
+    	m_state->stats = Stats();
+    }
+
+    JParseCache::~JParseCache() {}
+
+    std::shared_ptr<const JSnapshot> JParseCache::load(const string& text) {
+    	size_t hash = std::hash<string>()(text);
+    	State& st = *m_state;
+    	{
+    		std::lock_guard<std::mutex> lock(st.mutex);
+    		auto iter = st.index.find(hash);
+    		if(iter != st.index.end() && iter->second->text == text) {
+    			st.lru.splice(st.lru.begin(), st.lru, iter->second);
+    			++st.stats.hits;
+    			return iter->second->doc;
+    		}
+    		++st.stats.misses;
+    	}
+
+    	// parse unlocked, a racing miss on the same text keeps the later copy
+    	std::shared_ptr<const JSnapshot> doc = std::make_shared<JSnapshot>(Json::load(text).freeze());
+    	size_t cost = text.size() + doc->size();
+    	std::lock_guard<std::mutex> lock(st.mutex);
+    	if(cost > st.max_bytes)
+    		return doc;
+    	auto iter = st.index.find(hash);
+    	if(iter != st.index.end()) {
+    		st.stats.bytes -= iter->second->cost;
+    		--st.stats.entries;
+    		st.lru.erase(iter->second);
+    		st.index.erase(iter);
+    	}
+    	st.lru.push_front(State::Entry { hash, text, doc, cost });
+    	st.index[hash] = st.lru.begin();
+    	st.stats.bytes += cost;
+    	++st.stats.entries;
+    	evict(st.max_bytes);
+    	return doc;
+    }
+
+    // the caller holds the lock
+    void JParseCache::evict(size_t max_bytes) {
+    	State& st = *m_state;
+    	while(st.stats.bytes > max_bytes) {
+    		State::Entry& last = st.lru.back();
+    		st.stats.bytes -= last.cost;
+    		--st.stats.entries;
+    		++st.stats.evictions;
+    		st.index.erase(last.hash);
+    		st.lru.pop_back();
+    	}
+    }
+
+    void JParseCache::set_max_bytes(size_t max_bytes) {
+    	std::lock_guard<std::mutex> lock(m_state->mutex);
+    	m_state->max_bytes = max_bytes;
+    	evict(max_bytes);
+    }
+
+    JParseCache::Stats JParseCache::stats() const {
+    	std::lock_guard<std::mutex> lock(m_state->mutex);
+    	return m_state->stats;
+    }
+
+    void JParseCache::clear() {
+    	std::lock_guard<std::mutex> lock(m_state->mutex);
+    	m_state->lru.clear();
+    	m_state->index.clear();
+    	m_state->stats.entries = 0;
+    	m_state->stats.bytes = 0;
+    }
+
+    // JSON Patch
+    void Json::detach() {
+    	if(m_ptr.use_count() > 1) {
+    		if(is_array())
+    			m_ptr = make_node<JArray>(m_ptr->get_array());
+    		else if(is_object())
+    			m_ptr = make_node<JObject>(m_ptr->get_object());
+    	}
+    	m_ptr->touch();
+    }
+
+    namespace {
+    	const Json& patch_member(const Json& op, const char* name) {
+    		const Json::Jobject* o = &op.get_object();
+    		auto iter = o->find(name);
+    		if(iter == o->end())
+    			throw std::logic_error("PATCH_INVALID_OPERATION");
+    		return iter->second;
+    	}
+    	JPointer patch_path(const Json& op, const char* name) {
+    		const Json& path = patch_member(op, name);
+    		if(!path.is_string())
+    			throw std::logic_error("PATCH_INVALID_OPERATION");
+    		return JPointer(path.get_string());
+    	}
+    }
+
+    void Json::apply_patch(const Json& patch) {
+    	if(!patch.is_array())
+    		throw std::logic_error("PATCH_INVALID_OPERATION");
+
+    	// each step is undone by one of these, newest first
+    	enum Undo { UNDO_REMOVE, UNDO_ADD, UNDO_SET };
+    	struct Step {
+    		Undo undo;
+    		JPointer path;
+    		Json value;
+    	};
+    	std::vector<Step> log;
+
+    	// records how to undo an add at path
+    	auto add = [&](const JPointer& path, Json value) {
+    		if(path.empty()) {
+    			log.push_back(Step { UNDO_SET, path, *this });
+    			path.add(*this, move(value));
+    			return;
+    		}
+    		Step step { UNDO_REMOVE, path, Json() };
+    		JPointer parent_path = path;
+    		parent_path.m_tokens.pop_back();
+    		const Json* p = parent_path.find(*this);
+    		if(p && p->is_array() && path.m_tokens.back().index == JPointer::end) {
+    			size_t i = p->get_array().size();
+    			step.path.m_tokens.back() = JPointer::Token { std::to_string(i), i };
+    		} else if(p && p->is_object()) {
+    			const Json* old = path.find(*this);
+    			if(old) {
+    				step.undo = UNDO_SET;
+    				step.value = *old;
+    			}
+    		}
+    		path.add(*this, move(value));
+    		log.push_back(move(step));
+    	};
+    	auto remove = [&](const JPointer& path) {
+    		Json removed = path.remove(*this);
+    		log.push_back(Step { path.empty() ? UNDO_SET : UNDO_ADD, path, removed });
+    		return removed;
+    	};
+
+    	try {
+    		for(auto& op : patch.get_array()) {
+    			if(!op.is_object())
+    				throw std::logic_error("PATCH_INVALID_OPERATION");
+    			const Json& name = patch_member(op, "op");
+    			if(!name.is_string())
+    				throw std::logic_error("PATCH_INVALID_OPERATION");
+    			const string& kind = name.get_string();
+    			JPointer path = patch_path(op, "path");
+
+    			if(kind == "add") {
+    				add(path, patch_member(op, "value"));
+    			} else if(kind == "remove") {
+    				remove(path);
+    			} else if(kind == "replace") {
+    				const Json& value = patch_member(op, "value");
+    				Json old = path.get(*this);
+    				path.set(*this, value);
+    				log.push_back(Step { UNDO_SET, path, old });
+    			} else if(kind == "move") {
+    				JPointer from = patch_path(op, "from");
+    				string src = from.to_string(), dst = path.to_string();
+    				if(dst.compare(0, src.size(), src) == 0 && dst.size() > src.size() && dst[src.size()] == '/')
+    					throw std::logic_error("PATCH_INVALID_OPERATION");
+    				add(path, remove(from));
+    			} else if(kind == "copy") {
+    				add(path, patch_path(op, "from").get(*this));
+    			} else if(kind == "test") {
+    				if(path.get(*this) != patch_member(op, "value"))
+    					throw std::logic_error("PATCH_TEST_FAILED");
+    			} else {
+    				throw std::logic_error("PATCH_INVALID_OPERATION");
+    			}
+    		}
+    	} catch(...) {
+    		for(auto iter = log.rbegin(); iter != log.rend(); ++iter) {
+    			switch(iter->undo) {
+    				case UNDO_REMOVE: iter->path.remove(*this); break;
+    				case UNDO_ADD:    iter->path.add(*this, iter->value); break;
+    				case UNDO_SET:    iter->path.set(*this, iter->value); break;
+    			}
+    		}
     		throw;
     	}
+    }
 
-    	return result;
-    } 
+    void Json::merge_patch(const Json& patch) {
+    	const Jobject* src = patch.object_ptr();
+    	if(!src) {
+    		*this = patch;
+    		return;
+    	}
+    	if(is_object())
+    		detach();
+    	else
+    		m_ptr = make_node<JObject>(Jobject());
+    	Jobject& dst = *object_ptr();
+    	for(auto& member : *src) {
+    		if(member.second.is_null())
+    			dst.erase(member.first);
+    		else
+    			dst[member.first].merge_patch(member.second);
+    	}
+    }
+
+    // JSON diff
+    namespace {
+    	void append_token(string& path, const string& key) {
+    		path += '/';
+    		for(char ch : key) {
+    			if(ch == '~')
+    				path += "~0";
+    			else if(ch == '/')
+    				path += "~1";
+    			else
+    				path += ch;
+    		}
+    	}
+    	Json patch_op(const char* op, const string& path) {
+    		Json::Jobject o;
+    		o.emplace("op", op);
+    		o.emplace("path", path);
+    		return o;
+    	}
+    	Json patch_op(const char* op, const string& path, const Json& value) {
+    		Json::Jobject o;
+    		o.emplace("op", op);
+    		o.emplace("path", path);
+    		o.emplace("value", value);
+    		return o;
+    	}
+
+    	enum Edit { EDIT_KEEP, EDIT_REMOVE, EDIT_INSERT };
+    	const size_t max_diff_trace = 1 << 22;
+
+    	// Myers O((N+M)D) shortest edit script, false when the trace gets too big
+    	bool shortest_edit(const Json* a, int n, const Json* b, int m, std::vector<Edit>& script) {
+    		int max = n + m, offset = max;
+    		std::vector<int> v(2 * max + 2, 0);
+    		std::vector<std::vector<int>> trace;   // v[-d..d] before step d
+    		size_t traced = 0;
+    		int d = 0;
+    		for(;; ++d) {
+    			traced += 2 * d + 1;
+    			if(traced > max_diff_trace)
+    				return false;
+    			trace.emplace_back(v.begin() + offset - d, v.begin() + offset + d + 1);
+    			bool done = false;
+    			for(int k = -d; k <= d; k += 2) {
+    				int x = (k == -d || (k != d && v[offset+k-1] < v[offset+k+1])) ? v[offset+k+1] : v[offset+k-1] + 1;
+    				int y = x - k;
+    				while(x < n && y < m && a[x] == b[y]) {
+    					++x;
+    					++y;
+    				}
+    				v[offset+k] = x;
+    				if(x >= n && y >= m) {
+    					done = true;
+    					break;
+    				}
+    			}
+    			if(done)
+    				break;
+    		}
+
+    		int x = n, y = m;
+    		for(; d > 0; --d) {
+    			const int* pv = trace[d].data() + d;
+    			int k = x - y;
+    			int pk = (k == -d || (k != d && pv[k-1] < pv[k+1])) ? k + 1 : k - 1;
+    			int px = pv[pk], py = px - pk;
+    			for(; x > px && y > py; --x, --y)
+    				script.push_back(EDIT_KEEP);
+    			script.push_back(pk == k + 1 ? EDIT_INSERT : EDIT_REMOVE);
+    			x = px;
+    			y = py;
+    		}
+    		for(; x > 0; --x)
+    			script.push_back(EDIT_KEEP);
+    		std::reverse(script.begin(), script.end());
+    		return true;
+    	}
+    }
+
+    Json Json::diff(const Json& from, const Json& to) {
+    	Jarray out;
+    	string path;
+    	diff(from, to, path, out);
+    	return out;
+    }
+
+    void Json::diff(const Json& from, const Json& to, string& path, Jarray& out) {
+    	if(from.m_ptr == to.m_ptr)
+    		return;
+    	Jtype t = from.get_type();
+    	if(t != to.get_type() || (t != JARRAY && t != JOBJECT)) {
+    		if(from != to)
+    			out.push_back(patch_op("replace", path, to));
+    		return;
+    	}
+    	if(t == JARRAY) {
+    		diff(from.get_array(), to.get_array(), path, out);
+    		return;
+    	}
+
+    	// both objects: merge walk over the sorted keys
+    	const Jobject& a = from.get_object();
+    	const Jobject& b = to.get_object();
+    	size_t len = path.size();
+    	auto i = a.cbegin(), j = b.cbegin();
+    	while(i != a.cend() || j != b.cend()) {
+    		if(j == b.cend() || (i != a.cend() && i->first < j->first)) {
+    			append_token(path, i->first);
+    			out.push_back(patch_op("remove", path));
+    			++i;
+    		} else if(i == a.cend() || j->first < i->first) {
+    			append_token(path, j->first);
+    			out.push_back(patch_op("add", path, j->second));
+    			++j;
+    		} else {
+    			append_token(path, i->first);
+    			diff(i->second, j->second, path, out);
+    			++i;
+    			++j;
+    		}
+    		path.resize(len);
+    	}
+    }
+
+    void Json::diff(const Jarray& a, const Jarray& b, string& path, Jarray& out) {
+    	size_t len = path.size();
+    	size_t lo = 0, ha = a.size(), hb = b.size();
+    	while(lo < ha && lo < hb && a[lo] == b[lo])
+    		++lo;
+    	while(ha > lo && hb > lo && a[ha-1] == b[hb-1]) {
+    		--ha;
+    		--hb;
+    	}
+
+    	std::vector<Edit> script;
+    	if(!shortest_edit(a.data() + lo, int(ha - lo), b.data() + lo, int(hb - lo), script)) {
+    		// too many changes for an edit script, pair elements up by position
+    		script.clear();
+    		for(size_t k = lo; k < std::min(ha, hb); ++k) {
+    			script.push_back(EDIT_REMOVE);
+    			script.push_back(EDIT_INSERT);
+    		}
+    		for(size_t k = hb; k < ha; ++k)
+    			script.push_back(EDIT_REMOVE);
+    		for(size_t k = ha; k < hb; ++k)
+    			script.push_back(EDIT_INSERT);
+    	}
+
+    	// walk the script, a run of removes followed by inserts becomes nested changes
+    	size_t pos = lo, x = lo, y = lo;
+    	for(size_t s = 0; s < script.size();) {
+    		if(script[s] == EDIT_KEEP) {
+    			++pos; ++x; ++y; ++s;
+    			continue;
+    		}
+    		size_t removes = 0, inserts = 0;
+    		while(s + removes < script.size() && script[s + removes] == EDIT_REMOVE)
+    			++removes;
+    		while(s + removes + inserts < script.size() && script[s + removes + inserts] == EDIT_INSERT)
+    			++inserts;
+    		size_t paired = std::min(removes, inserts);
+    		for(size_t k = 0; k < paired; ++k, ++pos, ++x, ++y) {
+    			path += '/';
+    			path += std::to_string(pos);
+    			diff(a[x], b[y], path, out);
+    			path.resize(len);
+    		}
+    		for(size_t k = paired; k < removes; ++k, ++x) {
+    			path += '/';
+    			path += std::to_string(pos);
+    			out.push_back(patch_op("remove", path));
+    			path.resize(len);
+    		}
+    		for(size_t k = paired; k < inserts; ++k, ++pos, ++y) {
+    			path += '/';
+    			path += std::to_string(pos);
+    			out.push_back(patch_op("add", path, b[y]));
+    			path.resize(len);
+    		}
+    		s += removes + inserts;
+    	}
+    }
+
+    // schema
+    namespace {
+    	size_t schema_count(const Json& v) {
+    		if(!v.is_number() || v.get_number() < 0)
+    			throw std::logic_error("SCHEMA_INVALID");
+    		return static_cast<size_t>(v.get_number());
+    	}
+    	unsigned schema_type(const string& name, bool& integer) {
+    		if(name == "null")    return 1u << Json::JNULL;
+    		if(name == "boolean") return 1u << Json::JBOOL;
+    		if(name == "number")  return 1u << Json::JNUMBER;
+    		if(name == "string")  return 1u << Json::JSTRING;
+    		if(name == "array")   return 1u << Json::JARRAY;
+    		if(name == "object")  return 1u << Json::JOBJECT;
+    		if(name == "integer") {
+    			integer = true;
+    			return 1u << Json::JNUMBER;
+    		}
+    		throw std::logic_error("SCHEMA_INVALID");
+    	}
+
+    	// std::regex matchers mostly recurse once per input character, so a
+    	// long string can overflow the stack. libstdc++'s breadth first
+    	// matcher recurses over the pattern only; it rejects back references,
+    	// and those patterns, like every pattern elsewhere, are only run on
+    	// strings short enough for a small thread stack.
+    	const size_t schema_max_pattern_input = 256;
+
+    	std::unique_ptr<std::regex> schema_regex(const string& pattern, size_t& max_input) {
+    		const std::regex::flag_type flags = std::regex::ECMAScript | std::regex::optimize;
+#ifdef __GLIBCXX__
+    		try {
+    			max_input = static_cast<size_t>(-1);
+    			return std::unique_ptr<std::regex>(new std::regex(pattern, flags | std::regex_constants::__polynomial));
+    		} catch(const std::regex_error&) {
+    		}
+#endif
+    		try {
+    			max_input = schema_max_pattern_input;
+    			return std::unique_ptr<std::regex>(new std::regex(pattern, flags));
+    		} catch(const std::regex_error&) {
+    			throw std::logic_error("SCHEMA_INVALID");
+    		}
+    	}
+
+    	std::unique_ptr<JSchema::Node> schema_compile(const Json& schema) {
+    		std::unique_ptr<JSchema::Node> node(new JSchema::Node());
+    		if(schema.is_bool()) {
+    			if(!schema.get_bool())
+    				node->types = 0;
+    			return node;
+    		}
+    		if(!schema.is_object())
+    			throw std::logic_error("SCHEMA_INVALID");
+
+    		const Json::Jobject& o = schema.get_object();
+    		auto iter = o.find("type");
+    		if(iter != o.end()) {
+    			bool integer = false, number = false;
+    			node->types = 0;
+    			if(iter->second.is_string()) {
+    				node->types = schema_type(iter->second.get_string(), integer);
+    				number = iter->second.get_string() == "number";
+    			} else if(iter->second.is_array()) {
+    				for(auto& t : iter->second.get_array()) {
+    					if(!t.is_string())
+    						throw std::logic_error("SCHEMA_INVALID");
+    					node->types |= schema_type(t.get_string(), integer);
+    					number = number || t.get_string() == "number";
+    				}
+    			} else {
+    				throw std::logic_error("SCHEMA_INVALID");
+    			}
+    			node->integer = integer && !number;
+    		}
+    		bool exclusive_minimum = false, exclusive_maximum = false;  // draft 4 flags
+    		for(auto& member : o) {
+    			const string& k = member.first;
+    			const Json& v = member.second;
+    			if(k == "minimum" || k == "maximum") {
+    				if(!v.is_number())
+    					throw std::logic_error("SCHEMA_INVALID");
+    				(k == "minimum" ? node->minimum : node->maximum) = v.get_number();
+    			} else if(k == "exclusiveMinimum" || k == "exclusiveMaximum") {
+    				bool minimum = k == "exclusiveMinimum";
+    				if(v.is_bool()) {                      // draft 4
+    					(minimum ? exclusive_minimum : exclusive_maximum) = v.get_bool();
+    				} else if(v.is_number()) {
+    					(minimum ? node->exclusive_minimum : node->exclusive_maximum) = v.get_number();
+    				} else {
+    					throw std::logic_error("SCHEMA_INVALID");
+    				}
+    			} else if(k == "minLength") {
+    				node->min_length = schema_count(v);
+    			} else if(k == "maxLength") {
+    				node->max_length = schema_count(v);
+    			} else if(k == "minItems") {
+    				node->min_items = schema_count(v);
+    			} else if(k == "maxItems") {
+    				node->max_items = schema_count(v);
+    			} else if(k == "pattern") {
+    				if(!v.is_string())
+    					throw std::logic_error("SCHEMA_INVALID");
+    				node->pattern = schema_regex(v.get_string(), node->pattern_max_input);
+    			} else if(k == "enum") {
+    				if(!v.is_array())
+    					throw std::logic_error("SCHEMA_INVALID");
+    				node->enums.insert(v.get_array().begin(), v.get_array().end());
+    			} else if(k == "required") {
+    				if(!v.is_array())
+    					throw std::logic_error("SCHEMA_INVALID");
+    				for(auto& key : v.get_array()) {
+    					if(!key.is_string())
+    						throw std::logic_error("SCHEMA_INVALID");
+    					node->required.emplace(key.get_string(), node->required.size());
+    				}
+    			} else if(k == "properties") {
+    				if(!v.is_object())
+    					throw std::logic_error("SCHEMA_INVALID");
+    				for(auto& property : v.get_object())
+    					node->properties[property.first] = schema_compile(property.second);
+    			} else if(k == "items") {
+    				node->items = schema_compile(v);
+    			}
+    		}
+    		// draft 4 makes minimum and maximum themselves exclusive
+    		if(exclusive_minimum) {
+    			node->exclusive_minimum = std::max(node->exclusive_minimum, node->minimum);
+    			node->minimum = -HUGE_VAL;
+    		}
+    		if(exclusive_maximum) {
+    			node->exclusive_maximum = std::min(node->exclusive_maximum, node->maximum);
+    			node->maximum = HUGE_VAL;
+    		}
+    		return node;
+    	}
+
+    	// returns the failed check, path is built while unwinding
+    	const char* schema_validate(const JSchema::Node& node, const Json& v, string& path) {
+    		const char* error = schema_check_type(node, v.get_type());
+    		if(error)
+    			return error;
+    		switch(v.get_type()) {
+    			case Json::JNUMBER:
+    				error = schema_check_number(node, v.get_number());
+    				break;
+    			case Json::JSTRING:
+    				error = schema_check_string(node, v.get_string());
+    				break;
+    			case Json::JARRAY: {
+    				const Json::Jarray& values = v.get_array();
+    				if(values.size() < node.min_items || values.size() > node.max_items)
+    					return "SCHEMA_ITEMS_OUT_OF_RANGE";
+    				for(size_t i = 0; node.items && i < values.size(); ++i) {
+    					error = schema_validate(*node.items, values[i], path);
+    					if(error) {
+    						path.insert(0, "/" + std::to_string(i));
+    						return error;
+    					}
+    				}
+    				break;
+    			}
+    			case Json::JOBJECT: {
+    				const Json::Jobject& values = v.get_object();
+    				for(auto& key : node.required) {
+    					if(values.find(key.first) == values.end()) {
+    						append_token(path, key.first);
+    						return "SCHEMA_MISS_REQUIRED";
+    					}
+    				}
+    				for(auto& property : node.properties) {
+    					auto iter = values.find(property.first);
+    					if(iter == values.end())
+    						continue;
+    					error = schema_validate(*property.second, iter->second, path);
+    					if(error) {
+    						string token;
+    						append_token(token, property.first);
+    						path.insert(0, token);
+    						return error;
+    					}
+    				}
+    				break;
+    			}
+    			default:
+    				break;
+    		}
+    		return error ? error : schema_check_enum(node, v);
+    	}
+    }
+
+    JSchema::JSchema(const Json& schema) : m_root(schema_compile(schema)) {}
+
+    bool JSchema::validate(const Json& value, string* error) const {
+    	string path;
+    	const char* code = schema_validate(*m_root, value, path);
+    	if(code && error) {
+    		*error = code;
+    		if(!path.empty())
+    			*error += " " + path;
+    	}
+    	return code == nullptr;
+    }
+
+    // memory usage
+    size_t JMemoryUsage::total() const {
+    	size_t n = 0;
+    	for(auto& usage : types)
+    		n += usage.payload + usage.overhead;
+    	return n;
+    }
+
+    JMemoryUsage Json::memory_usage() const {
+    	struct Walker {
+    		std::unordered_map<const JValue*, long> refs;     // handles inside this tree
+    		JMemoryUsage usage;
+#ifdef CCJSON_SINGLE_THREADED
+    		size_t control_block = 0;                      // the count lives in the node
+#else
+    		// shared_ptr control block: vptr plus use and weak counts
+    		size_t control_block = sizeof(void*) + 2 * sizeof(int);
+#endif
+    		size_t map_node = 4 * sizeof(void*) + sizeof(Jobject::value_type);
+
+    		static size_t heap(const string& s) {
+    			const char* p = s.data();
+    			const char* self = reinterpret_cast<const char*>(&s);
+    			return (p >= self && p < self + sizeof(string)) ? 0 : s.capacity() + 1;
+    		}
+
+    		void count(const Json& v) {
+    			if(refs[v.m_ptr.get()]++ > 0)
+    				return;
+    			if(const Jarray* a = v.array_ptr()) {
+    				for(auto& e : *a)
+    					count(e);
+    			} else if(const Jobject* o = v.object_ptr()) {
+    				for(auto& m : *o)
+    					count(m.second);
+    			}
+    		}
+
+    		void measure(const Json& v, bool shared) {
+    			auto iter = refs.find(v.m_ptr.get());
+    			if(iter->second < 0)
+    				return;                                    // already measured
+    			shared = shared || v.m_ptr.use_count() > iter->second;
+    			iter->second = -1;
+
+    			Jtype t = v.get_type();
+    			size_t payload = 0, bytes = control_block;
+    			switch(t) {
+    				case JNULL:   bytes += sizeof(JNull); break;
+    				case JBOOL:   bytes += sizeof(JBool);   payload = sizeof(bool);   break;
+    				case JNUMBER:
+    					if(const JRawNumber* raw = dynamic_cast<const JRawNumber*>(v.m_ptr.get())) {
+    						bytes += sizeof(JRawNumber) + heap(raw->text());
+    						payload = raw->text().size();
+    					} else {
+    						bytes += sizeof(JDouble);
+    						payload = sizeof(double);
+    					}
+    					break;
+    				case JSTRING:
+    					bytes += sizeof(JString) + heap(v.get_string());
+    					payload = v.get_string().size();
+    					break;
+    				case JARRAY:
+    					bytes += sizeof(JArray) + v.get_array().capacity() * sizeof(Json);
+    					for(auto& e : v.get_array())
+    						measure(e, shared);
+    					break;
+    				case JOBJECT:
+    					bytes += sizeof(JObject);
+    					for(auto& m : v.get_object()) {
+    						bytes += map_node + heap(m.first);
+    						payload += m.first.size();
+    						measure(m.second, shared);
+    					}
+    					break;
+    			}
+    			JMemoryUsage::Usage& u = usage.types[t];
+    			++u.nodes;
+    			u.payload += payload;
+    			u.overhead += bytes - std::min(bytes, payload);
+    			if(shared)
+    				usage.shared += std::max(bytes, payload);
+    		}
+    	};
+
+    	Walker walker;
+    	walker.count(*this);
+    	walker.measure(*this, false);
+    	return walker.usage;
+    }
+
+    // binary snapshot
+    namespace {
+    	const char snapshot_magic[4] = { 'C', 'C', 'J', 'B' };
+    	const uint32_t snapshot_version = 1;
+    	const size_t snapshot_header = 16;   // magic, version, root, size
+
+    	struct JBinaryWriter final {
+    		string& out;
+    		size_t base;
+    		std::map<const void*, uint32_t> written;   // shared nodes are stored once
+    		std::map<string, uint32_t> keys;
+
+    		void align() {
+    			out.append((8 - (out.size() - base) % 8) % 8, '\0');
+    		}
+    		uint32_t offset() const {
+    			if(out.size() - base > std::numeric_limits<uint32_t>::max())
+    				throw std::length_error("SNAPSHOT_TOO_LARGE");
+    			return static_cast<uint32_t>(out.size() - base);
+    		}
+    		void put(uint32_t v) {
+    			out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+    		}
+    		void patch(size_t pos, uint32_t v) {
+    			memcpy(&out[pos], &v, sizeof(v));
+    		}
+    		uint32_t node(Json::Jtype t, uint32_t n) {
+    			align();
+    			uint32_t off = offset();
+    			put(t);
+    			put(n);
+    			return off;
+    		}
+    		uint32_t write_string(const string& v) {
+    			if(v.size() > std::numeric_limits<uint32_t>::max())
+    				throw std::length_error("SNAPSHOT_TOO_LARGE");
+    			uint32_t off = node(Json::JSTRING, static_cast<uint32_t>(v.size()));
+    			out.append(v.c_str(), v.size() + 1);
+    			return off;
+    		}
+    		uint32_t write_key(const string& key) {
+    			auto iter = keys.find(key);
+    			if(iter != keys.end())
+    				return iter->second;
+    			uint32_t off = write_string(key);
+    			keys.emplace(key, off);
+    			return off;
+    		}
+    		uint32_t write(const Json& v) {
+    			const void* id = nullptr;
+    			switch(v.get_type()) {
+    				case Json::JSTRING: id = &v.get_string(); break;
+    				case Json::JARRAY:  id = &v.get_array();  break;
+    				case Json::JOBJECT: id = &v.get_object(); break;
+    				default: break;
+    			}
+    			if(id) {
+    				auto iter = written.find(id);
+    				if(iter != written.end())
+    					return iter->second;
+    			}
+
+    			uint32_t off = 0;
+    			switch(v.get_type()) {
+    				case Json::JNULL:
+    					off = node(Json::JNULL, 0);
+    					break;
+    				case Json::JBOOL:
+    					off = node(Json::JBOOL, v.get_bool());
+    					break;
+    				case Json::JNUMBER: {
+    					off = node(Json::JNUMBER, 0);
+    					double d = v.get_number();
+    					out.append(reinterpret_cast<const char*>(&d), sizeof(d));
+    					break;
+    				}
+    				case Json::JSTRING:
+    					off = write_string(v.get_string());
+    					break;
+    				case Json::JARRAY: {
+    					const Json::Jarray& values = v.get_array();
+    					off = node(Json::JARRAY, static_cast<uint32_t>(values.size()));
+    					size_t table = out.size();
+    					out.append(values.size() * sizeof(uint32_t), '\0');
+    					for(size_t i = 0; i < values.size(); ++i)
+    						patch(table + i * sizeof(uint32_t), write(values[i]));
+    					break;
+    				}
+    				case Json::JOBJECT: {
+    					const Json::Jobject& values = v.get_object();
+    					off = node(Json::JOBJECT, static_cast<uint32_t>(values.size()));
+    					size_t table = out.size();
+    					out.append(values.size() * 2 * sizeof(uint32_t), '\0');
+    					for(auto iter = values.cbegin(); iter != values.cend(); ++iter, table += 2 * sizeof(uint32_t)) {
+    						patch(table, write_key(iter->first));
+    						patch(table + sizeof(uint32_t), write(iter->second));
+    					}
+    					break;
+    				}
+    			}
+    			if(id)
+    				written.emplace(id, off);
+    			return off;
+    		}
+    	};
+    }
+
+    void Json::dump_binary(string& out) const {
+    	size_t start = out.size();
+    	out.append(snapshot_magic, sizeof(snapshot_magic));
+    	out.append(snapshot_header - sizeof(snapshot_magic), '\0');
+    	JBinaryWriter writer { out, start };
+    	uint32_t root = writer.write(*this);
+    	writer.align();
+    	uint32_t size = writer.offset();
+    	writer.patch(start + 4, snapshot_version);
+    	writer.patch(start + 8, root);
+    	writer.patch(start + 12, size);
+    }
+
+    uint32_t JView::word(size_t i) const {
+    	uint32_t v;
+    	memcpy(&v, m_base + m_off + i * sizeof(uint32_t), sizeof(v));
+    	return v;
+    }
+
+    Json::Jtype JView::get_type() const {
+    	if(!m_base)
+    		throw std::runtime_error("INVALID_VIEW");
+    	return static_cast<Json::Jtype>(word(0));
+    }
+    double JView::get_number() const {
+    	if(get_type() != Json::JNUMBER)
+    		throw std::runtime_error("NOT_NUMBER");
+    	double v;
+    	memcpy(&v, m_base + m_off + 8, sizeof(v));
+    	return v;
+    }
+    bool JView::get_bool() const {
+    	if(get_type() != Json::JBOOL)
+    		throw std::runtime_error("NOT_BOOL");
+    	return word(1) != 0;
+    }
+    const char* JView::string_data() const {
+    	if(get_type() != Json::JSTRING)
+    		throw std::runtime_error("NOT_STRING");
+    	return m_base + m_off + 8;
+    }
+    size_t JView::string_size() const {
+    	if(get_type() != Json::JSTRING)
+    		throw std::runtime_error("NOT_STRING");
+    	return word(1);
+    }
+    size_t JView::size() const {
+    	Json::Jtype t = get_type();
+    	if(t != Json::JARRAY && t != Json::JOBJECT)
+    		throw std::runtime_error("NOT_ARRAY");
+    	return word(1);
+    }
+    JView JView::operator[](size_t i) const {
+    	if(get_type() != Json::JARRAY)
+    		throw std::runtime_error("NOT_ARRAY");
+    	if(i >= word(1))
+    		throw std::out_of_range("INDEX_OUT_OF_RANGE");
+    	return JView(m_base, word(2 + i));
+    }
+    JView JView::operator[](const string& key) const {
+    	JView v = find(key);
+    	if(!v.valid())
+    		throw std::out_of_range(key);
+    	return v;
+    }
+    JView JView::key(size_t i) const {
+    	if(get_type() != Json::JOBJECT)
+    		throw std::runtime_error("NOT_OBJECT");
+    	if(i >= word(1))
+    		throw std::out_of_range("INDEX_OUT_OF_RANGE");
+    	return JView(m_base, word(2 + 2 * i));
+    }
+    JView JView::value(size_t i) const {
+    	if(get_type() != Json::JOBJECT)
+    		throw std::runtime_error("NOT_OBJECT");
+    	if(i >= word(1))
+    		throw std::out_of_range("INDEX_OUT_OF_RANGE");
+    	return JView(m_base, word(3 + 2 * i));
+    }
+    JView JView::find(const char* key) const {
+    	return find(key, strlen(key));
+    }
+
+    JView JView::find(const char* key, size_t len) const {
+    	if(get_type() != Json::JOBJECT)
+    		throw std::runtime_error("NOT_OBJECT");
+    	size_t lo = 0, hi = word(1);
+    	while(lo < hi) {
+    		size_t mid = lo + (hi - lo) / 2;
+    		JView k(m_base, word(2 + 2 * mid));
+    		size_t klen = k.word(1);
+    		int cmp = memcmp(m_base + k.m_off + 8, key, std::min(klen, len));
+    		if(cmp == 0)
+    			cmp = klen < len ? -1 : (klen > len ? 1 : 0);
+    		if(cmp == 0)
+    			return JView(m_base, word(3 + 2 * mid));
+    		if(cmp < 0)
+    			lo = mid + 1;
+    		else
+    			hi = mid;
+    	}
+    	return JView();
+    }
+
+    Json JView::to_json() const {
+    	switch(get_type()) {
+    		case Json::JNULL:   return Json();
+    		case Json::JBOOL:   return get_bool();
+    		case Json::JNUMBER: return get_number();
+    		case Json::JSTRING: return get_string();
+    		case Json::JARRAY: {
+    			Json::Jarray values;
+    			size_t n = size();
+    			values.reserve(n);
+    			for(size_t i = 0; i < n; ++i)
+    				values.push_back((*this)[i].to_json());
+    			return values;
+    		}
+    		case Json::JOBJECT: {
+    			Json::Jobject values;
+    			size_t n = size();
+    			for(size_t i = 0; i < n; ++i)
+    				values.emplace_hint(values.end(), key(i).get_string(), value(i).to_json());
+    			return values;
+    		}
+    	}
+    	return Json();
+    }
+
+    JSnapshot Json::freeze() const {
+    	return JSnapshot(dump_binary());
+    }
+
+    JSnapshot::JSnapshot(string bytes)
+    	: m_data(nullptr), m_size(0), m_mapped(false), m_buffer(move(bytes)) {
+    	m_data = m_buffer.data();
+    	m_size = m_buffer.size();
+    	check();
+    }
+
+    JSnapshot::JSnapshot(JSnapshot&& rhs) noexcept : JSnapshot() {
+    	*this = move(rhs);
+    }
+
+    JSnapshot& JSnapshot::operator=(JSnapshot&& rhs) noexcept {
+    	if(this != &rhs) {
+    		release();
+    		m_mapped = rhs.m_mapped;
+    		m_size = rhs.m_size;
+    		m_buffer = move(rhs.m_buffer);
+    		m_data = m_mapped ? rhs.m_data : m_buffer.data();
+    		rhs.m_data = nullptr;
+    		rhs.m_size = 0;
+    		rhs.m_mapped = false;
+    	}
+    	return *this;
+    }
+
+    JSnapshot::~JSnapshot() {
+    	release();
+    }
+
+    void JSnapshot::release() {
+#ifndef _WIN32
+    	if(m_mapped)
+    		munmap(const_cast<char*>(m_data), m_size);
+#endif
+    	m_data = nullptr;
+    	m_size = 0;
+    	m_mapped = false;
+    	m_buffer.clear();
+    }
+
+    JSnapshot JSnapshot::open(const string& path) {
+    	JSnapshot snapshot;
+#ifndef _WIN32
+    	int fd = ::open(path.c_str(), O_RDONLY);
+    	if(fd < 0)
+    		throw std::runtime_error("SNAPSHOT_OPEN_FAILED");
+    	struct stat st;
+    	if(fstat(fd, &st) != 0 || st.st_size == 0) {
+    		::close(fd);
+    		throw std::runtime_error("SNAPSHOT_OPEN_FAILED");
+    	}
+    	void* p = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    	::close(fd);
+    	if(p == MAP_FAILED)
+    		throw std::runtime_error("SNAPSHOT_OPEN_FAILED");
+    	snapshot.m_data = static_cast<const char*>(p);
+    	snapshot.m_size = static_cast<size_t>(st.st_size);
+    	snapshot.m_mapped = true;
+#else
+    	std::ifstream in(path, std::ios::binary);
+    	if(!in)
+    		throw std::runtime_error("SNAPSHOT_OPEN_FAILED");
+    	std::ostringstream bytes;
+    	bytes << in.rdbuf();
+    	snapshot.m_buffer = bytes.str();
+    	snapshot.m_data = snapshot.m_buffer.data();
+    	snapshot.m_size = snapshot.m_buffer.size();
+#endif
+    	snapshot.check();
+    	return snapshot;
+    }
+
+    void JSnapshot::check() const {
+    	uint32_t version, root, size;
+    	if(m_size < snapshot_header || memcmp(m_data, snapshot_magic, sizeof(snapshot_magic)) != 0)
+    		throw std::logic_error("SNAPSHOT_INVALID_FORMAT");
+    	memcpy(&version, m_data + 4, sizeof(uint32_t));
+    	memcpy(&root, m_data + 8, sizeof(uint32_t));
+    	memcpy(&size, m_data + 12, sizeof(uint32_t));
+    	if(version != snapshot_version || size != m_size || root < snapshot_header || root + 8 > size)
+    		throw std::logic_error("SNAPSHOT_INVALID_FORMAT");
+    }
+
+    JView JSnapshot::root() const {
+    	uint32_t root;
+    	memcpy(&root, m_data + 8, sizeof(uint32_t));
+    	return JView(m_data, root);
+    }
+
+    // element streaming
+    // Reads into a window and splits the root container at its top level
+    // commas, so the window holds the largest element plus a chunk instead of
+    // the whole text. A scalar root is read whole.
+    struct JElementReader::State {
+    	enum Stage { BEFORE, ITEMS, AFTER, SCALAR, DONE };
+
+    	Source source;
+    	void* user;
+    	size_t chunk;
+    	string text;              // read so far, text[pos..] not yet parsed
+    	size_t pos = 0;
+    	bool eof = false;
+    	Stage stage = BEFORE;
+    	Json::Jtype type = Json::JNULL;
+    	Json scalar;
+    	// sources owned by the reader
+    	const char* data = nullptr;
+    	size_t size = 0;
+    	std::ifstream file;
+
+    	static size_t read_buffer(char* buffer, size_t n, void* user) {
+    		State* st = static_cast<State*>(user);
+    		n = std::min(n, st->size);
+    		memcpy(buffer, st->data, n);
+    		st->data += n;
+    		st->size -= n;
+    		return n;
+    	}
+    	static size_t read_file(char* buffer, size_t n, void* user) {
+    		State* st = static_cast<State*>(user);
+    		st->file.read(buffer, static_cast<std::streamsize>(n));
+    		if(st->file.bad())
+    			throw std::runtime_error("STREAM_READ_FAILED");
+    		return static_cast<size_t>(st->file.gcount());
+    	}
+
+    	bool fill() {
+    		if(eof)
+    			return false;
+    		size_t old = text.size();
+    		text.resize(old + chunk);
+    		size_t n = source(&text[old], chunk, user);
+    		text.resize(old + n);
+    		if(n == 0)
+    			eof = true;
+    		return n > 0;
+    	}
+    	size_t skip_whitespace() {
+    		size_t i = pos;
+    		for(;;) {
+    			if(i == text.size() && !fill())
+    				return i;
+    			char ch = text[i];
+    			if(ch != ' ' && ch != '\t' && ch != '\n' && ch != '\r')
+    				return i;
+    			++i;
+    		}
+    	}
+    	// first ',', ']' or '}' after pos outside strings and nested
+    	// containers, or text.size() at the end of input
+    	size_t value_end() {
+    		size_t i = pos;
+    		int depth = 0;
+    		bool in_string = false, escape = false;
+    		for(;; ++i) {
+    			if(i == text.size() && !fill())
+    				return i;
+    			char ch = text[i];
+    			if(in_string) {
+    				if(escape)
+    					escape = false;
+    				else if(ch == '\\')
+    					escape = true;
+    				else if(ch == '\"')
+    					in_string = false;
+    			} else if(ch == '\"') {
+    				in_string = true;
+    			} else if(ch == '[' || ch == '{') {
+    				++depth;
+    			} else if(ch == ']' || ch == '}') {
+    				if(depth-- == 0)
+    					return i;
+    			} else if(ch == ',' && depth == 0) {
+    				return i;
+    			}
+    		}
+    	}
+    	const char* missing() const {
+    		return type == Json::JOBJECT ? "PARSE_MISS_COMMA_OR_CURLY_BRACKET" : "PARSE_MISS_COMMA_OR_SQUARE_BRACKET";
+    	}
+    	// parses text[pos, e) as one element or member of the root
+    	void parse_item(size_t e, JElement& out) {
+    		char saved = text[e];
+    		text[e] = '\0';
+    		JParser parser { text.data() + pos, text.data() + e };
+    		parser.parse_whitespace();
+    		out.key.clear();
+    		if(type == Json::JOBJECT) {
+    			if(*parser.cur != '\"' || !parser.parse_string(out.key))
+    				throw std::logic_error("PARSE_MISS_KEY");
+    			parser.parse_whitespace();
+    			if(*parser.cur != ':')
+    				throw std::logic_error("PARSE_MISS_COLON");
+    			++parser.cur;
+    			parser.parse_whitespace();
+    		}
+    		parser.check(parser.parse_value(1, out.value));
+    		parser.parse_whitespace();
+    		if(*parser.cur != '\0')
+    			throw std::logic_error(missing());
+    		text[e] = saved;
+    	}
+    	void start() {
+    		size_t i = skip_whitespace();
+    		if(i == text.size())
+    			throw std::logic_error("PARSE_EXPECT_VALUE");
+    		if(text[i] != '[' && text[i] != '{') {
+    			while(fill())
+    				;
+    			JParser parser { text.data() + i, text.data() + text.size() };
+    			parser.check(parser.parse_json(scalar));
+    			type = scalar.get_type();
+    			stage = SCALAR;
+    			return;
+    		}
+    		type = text[i] == '{' ? Json::JOBJECT : Json::JARRAY;
+    		pos = i + 1;
+    		i = skip_whitespace();
+    		if(i < text.size() && text[i] == (type == Json::JOBJECT ? '}' : ']')) {
+    			pos = i + 1;
+    			stage = AFTER;
+    		} else {
+    			stage = ITEMS;
+    		}
+    	}
+    	bool next(JElement& out) {
+    		if(stage == BEFORE)
+    			start();
+    		if(stage == SCALAR) {
+    			out.key.clear();
+    			out.value = move(scalar);
+    			stage = DONE;
+    			return true;
+    		}
+    		if(stage == AFTER) {
+    			stage = DONE;
+    			if(skip_whitespace() != text.size())
+    				throw std::logic_error("PARSE_ROOT_NOT_SINGULAR");
+    		}
+    		if(stage == DONE)
+    			return false;
+    		size_t e = value_end();
+    		parse_item(e, out);
+    		if(e == text.size())
+    			throw std::logic_error(missing());
+    		char delimiter = text[e];
+    		pos = e + 1;
+    		if(delimiter == (type == Json::JOBJECT ? '}' : ']'))
+    			stage = AFTER;
+    		else if(delimiter != ',')
+    			throw std::logic_error(missing());
+    		if(pos >= chunk) {
+    			text.erase(0, pos);
+    			pos = 0;
+    		}
+    		return true;
+    	}
+    };
+
+    JElementReader::JElementReader(Source source, void* user, size_t chunk_size) : m_state(new State()) {
+    	m_state->source = source;
+    	m_state->user = user;
+    	m_state->chunk = std::max<size_t>(chunk_size, 1);
+    }
+
+    JElementReader::JElementReader(const char* data, size_t size)
+    	: JElementReader(State::read_buffer, nullptr) {
+    	m_state->user = m_state.get();
+    	m_state->data = data;
+    	m_state->size = size;
+    }
+
+    JElementReader JElementReader::open(const string& path) {
+    	JElementReader reader(State::read_file, nullptr);
+    	reader.m_state->user = reader.m_state.get();
+    	reader.m_state->file.open(path, std::ios::binary);
+    	if(!reader.m_state->file)
+    		throw std::runtime_error("STREAM_OPEN_FAILED");
+    	return reader;
+    }
+
+    JElementReader::JElementReader(JElementReader&& rhs) noexcept = default;
+    JElementReader& JElementReader::operator=(JElementReader&& rhs) noexcept = default;
+    JElementReader::~JElementReader() {}
+
+    Json::Jtype JElementReader::type() {
+    	if(m_state->stage == State::BEFORE)
+    		m_state->start();
+    	return m_state->type;
+    }
+
+    bool JElementReader::next(JElement& out) {
+    	return m_state->next(out);
+    }
+
+    Json Json::load(JElementReader& reader) {
+    	JElement e;
+    	switch(reader.type()) {
+    		case JARRAY: {
+    			Jarray values;
+    			while(reader.next(e))
+    				values.push_back(move(e.value));
+    			return Json(move(values));
+    		}
+    		case JOBJECT: {
+    			Jobject values;
+    			while(reader.next(e))
+    				values[e.key] = move(e.value);
+    			return Json(move(values));
+    		}
+    		default:
+    			reader.next(e);
+    			return move(e.value);
+    	}
+    }
+
+#ifdef CCJSON_ZLIB
+    namespace {
+    	const size_t gzip_chunk = 64 * 1024;
+
+    	struct JGzipFile final {
+    		gzFile file;
+    		~JGzipFile() {
+    			if(file)
+    				gzclose(file);
+    		}
+    	};
+
+    	size_t gzip_read(char* buffer, size_t size, void* user) {
+    		int n = gzread(static_cast<gzFile>(user), buffer, static_cast<unsigned>(size));
+    		if(n < 0)
+    			throw std::runtime_error("GZIP_READ_FAILED");
+    		return static_cast<size_t>(n);
+    	}
+
+    	struct JGzipSink final {
+    		gzFile file;
+    		bool failed;
+    	};
+
+    	void gzip_write(const char* data, size_t size, void* user) {
+    		JGzipSink* sink = static_cast<JGzipSink*>(user);
+    		if(!sink->failed && size && gzwrite(sink->file, data, static_cast<unsigned>(size)) == 0)
+    			sink->failed = true;
+    	}
+    }
+
+    Json Json::load_gzip(const string& path) {
+    	JGzipFile in { gzopen(path.c_str(), "rb") };
+    	if(!in.file)
+    		throw std::runtime_error("GZIP_OPEN_FAILED");
+    	gzbuffer(in.file, static_cast<unsigned>(gzip_chunk));
+    	JElementReader reader(gzip_read, in.file, gzip_chunk);
+    	return load(reader);
+    }
+
+    void Json::dump_gzip(const string& path, int level) const {
+    	char mode[4] = "wb";
+    	if(level >= 0 && level <= 9)
+    		mode[2] = static_cast<char>('0' + level);
+    	JGzipFile out { gzopen(path.c_str(), mode) };
+    	if(!out.file)
+    		throw std::runtime_error("GZIP_OPEN_FAILED");
+    	gzbuffer(out.file, static_cast<unsigned>(gzip_chunk));
+    	JGzipSink sink { out.file, false };
+    	{
+    		JWriter writer(gzip_write, &sink, gzip_chunk);
+    		writer.value(*this);
+    		writer.flush();
+    	}
+    	gzFile file = out.file;
+    	out.file = nullptr;
+    	if(gzclose(file) != Z_OK || sink.failed)
+    		throw std::runtime_error("GZIP_WRITE_FAILED");
+    }
+#endif
 }
\ No newline at end of file
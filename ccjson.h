@@ -6,10 +6,77 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <tuple>
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#include <exception>
+#include <iterator>
+#define CCJSON_COROUTINES
+#endif
+#endif
+#if defined(CCJSON_HASH_CACHE) || defined(CCJSON_DUMP_CACHE)
+#define CCJSON_NODE_CACHE                          // nodes carry versions for the caches
+#endif
 
 namespace json {
 
 	class JValue;
+	class JView;
+	class JSnapshot;
+	class JPointer;
+	class JPath;
+	class JColumns;
+	struct JNodeCache;
+	class JElementReader;
+	class JProjection;
+	class JSchema;
+	struct JMemoryUsage;
+	struct JParseError;
+
+#ifdef CCJSON_SINGLE_THREADED
+	// handle counting references inside the node with a plain integer instead
+	// of a shared_ptr control block and atomics. Documents built this way must
+	// stay on one thread; freeze() them to share.
+	class JHandle final {
+	public:
+		JHandle() noexcept : m_p(nullptr) {}
+		explicit JHandle(JValue* p) noexcept;          // adopts a new node
+		JHandle(const JHandle& rhs) noexcept;
+		JHandle(JHandle&& rhs) noexcept : m_p(rhs.m_p) { rhs.m_p = nullptr; }
+		JHandle& operator=(JHandle rhs) noexcept {
+			JValue* p = m_p;
+			m_p = rhs.m_p;
+			rhs.m_p = p;
+			return *this;
+		}
+		~JHandle();
+
+		JValue* get()        const noexcept { return m_p; }
+		JValue* operator->() const noexcept { return m_p; }
+		JValue& operator*()  const noexcept { return *m_p; }
+		long use_count()     const noexcept;
+
+		bool operator==(const JHandle& rhs) const noexcept { return m_p == rhs.m_p; }
+		bool operator!=(const JHandle& rhs) const noexcept { return m_p != rhs.m_p; }
+
+	private:
+		JValue* m_p;
+	};
+#else
+	typedef std::shared_ptr<JValue> JHandle;
+#endif
+
+	// options for Json::load(in, flags)
+	enum JParseFlags : unsigned {
+		PARSE_DEFAULT       = 0,
+		PARSE_VALIDATE_UTF8 = 1,   // reject ill formed UTF-8 and lone surrogate escapes
+		PARSE_RAW_NUMBERS   = 2,   // keep numbers as their text, see Json::raw_number
+	};
 
 	class Json final {
 	public:
@@ -31,8 +98,16 @@ namespace json {
 		Json(Jarray&& value);                 // JARRAY
 		Json(const Jobject& value);           // JOBJECT
 		Json(Jobject&& value);                // JOBJECT
+		// JNUMBER kept as text, which must be exactly one finite JSON number
+		// (std::logic_error("PARSE_...") otherwise): dump writes it verbatim
+		// and every numeric read converts it. Loading with
+		// PARSE_RAW_NUMBERS builds these, so unmodified numbers round trip
+		// byte for byte and skip strtod/snprintf; set_value replaces the text.
+		static Json raw_number(std::string text);
 
 		Json(const Json& t):m_ptr(t.m_ptr) {}
+		// t is left null
+		Json(Json&& t) noexcept;
 
 		Jtype get_type() const;
 
@@ -44,6 +119,9 @@ namespace json {
 		bool is_object() const { return get_type() == JOBJECT; }
 
 		double get_number()              const;
+		// integers of raw numbers are exact; others truncate toward zero and
+		// throw std::out_of_range("NUMBER_OUT_OF_RANGE") outside int64_t
+		int64_t get_int64()              const;
 		bool   get_bool()                const;
 		const  std::string& get_string() const;
 		const  Jarray& get_array()       const;
@@ -65,6 +143,38 @@ namespace json {
 		Json& operator[](size_t i);
 		Json& operator[](const std::string& key);
 
+		// builder: grows an array or object in place, throws NOT_ARRAY or
+		// NOT_OBJECT otherwise. Like operator[], every handle sharing the node
+		// sees the change. Values are moved, never copied, along the way.
+		void push_back(const Json& value);
+		void push_back(Json&& value);
+		// constructs the element in the array from args
+		template <typename... Args>
+		Json& emplace_back(Args&&... args) {
+			Jarray& a = mutable_array();
+			a.emplace_back(std::forward<Args>(args)...);
+			return a.back();
+		}
+		void reserve(size_t n);
+		Json& insert_or_assign(std::string key, Json value);
+		// constructs the member from args unless key is already present
+		template <typename... Args>
+		std::pair<Jobject::iterator, bool> emplace(std::string key, Args&&... args) {
+			Jobject& o = mutable_object();
+			auto iter = o.lower_bound(key);
+			if(iter != o.end() && iter->first == key)
+				return std::make_pair(iter, false);
+			iter = o.emplace_hint(iter, std::piecewise_construct, std::forward_as_tuple(std::move(key)),
+								  std::forward_as_tuple(std::forward<Args>(args)...));
+			return std::make_pair(iter, true);
+		}
+
+		// Build with CCJSON_DUMP_CACHE to keep each array's and object's text
+		// once dumped: a later dump copies the text of unchanged subtrees and
+		// serializes only the nodes changed since, through whichever handle.
+		// Each dump first walks the tree to find those, and writes the cache,
+		// so do not dump one tree from several threads at once (freeze() it
+		// instead). Costs about one copy of the text per nesting level.
 		void dump(std::string& out) const;
 		std::string dump() const {
 			std::string out;
@@ -72,33 +182,389 @@ namespace json {
 			return out;
 		}
 
+		// compact binary tape, see JSnapshot
+		void dump_binary(std::string& out) const;
+		std::string dump_binary() const {
+			std::string out;
+			dump_binary(out);
+			return out;
+		}
+		// immutable copy for concurrent readers. JView handles into it are a
+		// pointer and an offset: reads take no locks and touch no refcounts.
+		JSnapshot freeze() const;
+
 		static Json load(const std::string& in);
 		static Json load(const char* in) {
 			return load(std::string(in));
 		}
+		static Json load(const std::string& in, JParseFlags flags);
+		// never throws on malformed input: returns null and fills error instead
+		static Json load(const std::string& in, JParseError& error);
+		static Json load(const std::string& in, JParseFlags flags, JParseError& error);
+		// builds only the nodes along the projected paths, see JProjection
+		static Json load(const std::string& in, const JProjection& projection);
+		// validates while parsing, throws std::logic_error("SCHEMA_...") on the
+		// first violation
+		static Json load(const std::string& in, const JSchema& schema);
+		// the remaining elements of the reader as one document
+		static Json load(JElementReader& reader);
+#ifdef CCJSON_ZLIB
+		// gzip files (plain ones are read as is) through a JElementReader
+		// inflating 64 KiB chunks
+		static Json load_gzip(const std::string& path);
+		// deflates while serializing through a JWriter; level 0-9, or -1 for
+		// zlib's default
+		void dump_gzip(const std::string& path, int level = -1) const;
+#endif
+
+		// RFC 6902 JSON Patch, all or nothing: throws and leaves *this unchanged
+		// on failure. Shared nodes on the touched paths are copied, the rest
+		// is changed in place.
+		void apply_patch(const Json& patch);
+		// RFC 7386 JSON Merge Patch
+		void merge_patch(const Json& patch);
+		// JSON Patch turning from into to, shared subtrees are skipped unvisited
+		static Json diff(const Json& from, const Json& to);
 
 		Json& operator=  (const Json& rhs);
 		Json& operator=  (Json&& rhs);
 		bool  operator== (const Json& rhs) const;
+		// total order: by Jtype first, then by value
 		bool  operator<  (const Json& rhs) const;
 		bool  operator!= (const Json& rhs) const { return !(*this == rhs); }
 		bool  operator<= (const Json& rhs) const { return !(rhs < *this); }
 		bool  operator>  (const Json& rhs) const { return (rhs < *this); }
 		bool  operator>= (const Json& rhs) const { return !(*this < rhs); }
 
+		// structural hash, equal values hash equally. Build with
+		// CCJSON_HASH_CACHE to cache it in arrays and objects: a rehash walks
+		// the tree but recomputes only subtrees changed since. Like dump, it
+		// writes the cache, so do not hash one tree from several threads.
+		size_t hash() const;
+
+		// approximate heap footprint of the tree, nodes reachable twice count once
+		JMemoryUsage memory_usage() const;
+
+	private:
+		friend class JPointer;
+		friend class JPath;
+		friend class JColumns;
+		friend struct JNodeCache;
+		friend struct JParser;                     // raw numbers it has already scanned
+
+		// non-throwing container access, nullptr on type mismatch
+		const Jarray* array_ptr()   const;
+		const Jobject* object_ptr() const;
+		Jarray* array_ptr();
+		Jobject* object_ptr();
+		// throwing forms of the above for the builder
+		Jarray& mutable_array();
+		Jobject& mutable_object();
+		// copy a shared container before changing it, drops the cached hash
+		void detach();
+		static void diff(const Json& from, const Json& to, std::string& path, Jarray& out);
+		static void diff(const Jarray& from, const Jarray& to, std::string& path, Jarray& out);
+
+		JHandle m_ptr;
+
+	};
+
+	struct JMemoryUsage {
+		struct Usage {
+			size_t nodes = 0;
+			size_t payload = 0;    // string and key bytes, number and bool values
+			size_t overhead = 0;   // nodes, control blocks, containers, spare capacity
+		};
+		Usage types[6];            // indexed by Json::Jtype
+		size_t shared = 0;         // bytes in nodes also referenced from outside the tree
+
+		size_t total() const;
+	};
+
+	// process wide Json node allocations, control blocks included. Counted
+	// only when built with CCJSON_ALLOC_STATS, all zero otherwise.
+	struct JAllocStats {
+		uint64_t allocations;
+		uint64_t deallocations;
+		uint64_t bytes_allocated;
+		uint64_t bytes_freed;
+
+		uint64_t live_nodes() const { return allocations - deallocations; }
+		uint64_t live_bytes() const { return bytes_allocated - bytes_freed; }
+	};
+	// why and where Json::load(in, error) stopped
+	struct JParseError {
+		const char* code;      // nullptr on success, else the code load(in) would throw
+		size_t offset;         // byte offset of the offending character
+		size_t line;           // 1-based
+		size_t column;         // 1-based, counted in bytes
+
+		explicit operator bool() const { return code != nullptr; }
+	};
+
+	JAllocStats alloc_stats();
+
+	// parse and dump counters. Collected only when built with CCJSON_STATS,
+	// all zero otherwise; the hooks compile to nothing in that case.
+	struct JStats {
+		static const int buckets = 24;   // latency bucket i holds calls under 2^i microseconds
+
+		uint64_t parse_calls;
+		uint64_t parse_bytes;
+		uint64_t parse_ns;
+		uint64_t dump_calls;
+		uint64_t dump_bytes;
+		uint64_t dump_ns;
+		uint64_t values[6];              // parsed values, indexed by Json::Jtype
+		uint64_t string_bytes;           // raw string and key bytes parsed, quotes excluded
+		uint64_t number_bytes;           // number text parsed
+		uint64_t max_depth;              // deepest nesting seen while parsing
+		uint64_t parse_latency[buckets];
+		uint64_t dump_latency[buckets];
+	};
+	JStats stats();
+	void reset_stats();
+
+	// called after every top level load or dump with the counters of that
+	// call alone. Runs on the calling thread, must not call load or dump.
+	typedef void (*JStatsHook)(const JStats& call, void* user);
+	void set_stats_hook(JStatsHook hook, void* user = nullptr);
+
+	// RFC 6901 JSON Pointer, parsed once and reusable against any document
+	class JPointer final {
+	public:
+		JPointer() {}                              // "" refers to the whole document
+		explicit JPointer(const std::string& path);
+		explicit JPointer(const char* path) : JPointer(std::string(path)) {}
+
+		// nullptr when the path does not exist
+		const Json* find(const Json& doc) const noexcept;
+		Json* find(Json& doc) const noexcept;
+		// throws std::out_of_range when the path does not exist
+		const Json& get(const Json& doc) const;
+		Json& get(Json& doc) const;
+		// Mutating calls copy shared nodes along the path first, so other
+		// documents sharing them are left untouched.
+		// replaces or adds the last token, "-" appends to an array
+		void set(Json& doc, Json value) const;
+		// RFC 6902 add: inserts into arrays, replaces object members
+		void add(Json& doc, Json value) const;
+		// returns the removed value
+		Json remove(Json& doc) const;
+
+		size_t size() const { return m_tokens.size(); }
+		bool empty() const { return m_tokens.empty(); }
+		const std::string& operator[](size_t i) const { return m_tokens[i].key; }
+		std::string to_string() const;
+
+	private:
+		friend class Json;
+		friend class JProjection;
+
+		static const size_t npos = static_cast<size_t>(-1);
+		static const size_t end  = npos - 1;       // "-"
+
+		struct Token {
+			std::string key;
+			size_t index;                          // npos if not an array index
+		};
+
+		static Json* step(Json& v, const Token& t) noexcept;
+		static const Json* step(const Json& v, const Token& t) noexcept;
+		Json* parent(Json& doc) const;
+
+		std::vector<Token> m_tokens;
+	};
+
+	// A set of pointers for Json::load(in, projection). Members off the paths
+	// are skipped without decoding; skipped array elements before a selected
+	// index become null so indices stay valid, later ones are dropped.
+	class JProjection final {
+	public:
+		struct Node;                               // opaque, defined in ccjson.cpp
+
+		explicit JProjection(const std::vector<JPointer>& paths);
+		JProjection(std::initializer_list<JPointer> paths)
+			: JProjection(std::vector<JPointer>(paths)) {}
+
+		const Node& root() const { return *m_root; }
+
 	private:
-		std::shared_ptr<JValue> m_ptr;
+		std::shared_ptr<const Node> m_root;
+	};
+
+	// Compiled JSONPath subset:
+	//   $                     the root
+	//   .name  ['name']       object member
+	//   .*  [*]               every element or member value
+	//   ..name  ..*  ..[...]  the same, at any depth below
+	//   [n]                   array element, negative counts from the end
+	//   [start:stop:step]     array slice, each bound optional
+	//   [?(@.a.b op literal)] elements whose field compares with op (one of
+	//                         == != < <= > >=) to a number, 'string', true,
+	//                         false or null; without op the field must exist
+	// Compile once and evaluate against any number of documents. Copies
+	// share the compiled steps.
+	class JPath final {
+	public:
+		struct Step;                               // opaque, defined in ccjson.cpp
+
+		// throws std::logic_error("PATH_...") on a malformed expression
+		explicit JPath(const std::string& expr);
+		explicit JPath(const char* expr) : JPath(std::string(expr)) {}
+
+		// appends the matches in document order; the pointers are valid
+		// until doc is modified
+		void find(const Json& doc, std::vector<const Json*>& out) const;
+		std::vector<const Json*> find(const Json& doc) const {
+			std::vector<const Json*> out;
+			find(doc, out);
+			return out;
+		}
+		// results[i] receives the matches in docs[i], keeping its capacity.
+		// docs are split over threads, 0 means one per hardware thread.
+		void find_all(const std::vector<Json>& docs, std::vector<std::vector<const Json*>>& results,
+					  unsigned threads = 0) const;
+
+	private:
+		void walk(const Json& v, size_t i, std::vector<const Json*>& out) const;
+		void select(const Json& v, size_t i, std::vector<const Json*>& out) const;
+
+		std::shared_ptr<const std::vector<Step>> m_steps;
+	};
+
+	// JSON Schema subset compiled once: type, required, properties, items,
+	// enum, minimum/maximum, exclusiveMinimum/exclusiveMaximum,
+	// minLength/maxLength, minItems/maxItems and pattern.
+	class JSchema final {
+	public:
+		struct Node;                               // opaque, defined in ccjson.cpp
+
+		explicit JSchema(const Json& schema);
+
+		// on failure *error holds "SCHEMA_... /pointer/to/value"
+		bool validate(const Json& value, std::string* error = nullptr) const;
+
+		const Node& root() const { return *m_root; }
+
+	private:
+		std::shared_ptr<const Node> m_root;
+	};
+
+	// Columnar copy of an array of objects: one contiguous column per
+	// requested field, for loops over a field of every row. A row whose field
+	// is missing, null or of another type has its validity bit cleared and
+	// holds 0 or an empty string. INT64 columns take integral numbers only.
+	// Row i of a STRING column is blob[offsets[i], offsets[i+1]).
+	class JColumns final {
+	public:
+		enum Kind { DOUBLE, INT64, STRING };
+
+		struct Column {
+			std::string name;
+			Kind kind;
+			std::vector<double> doubles;           // DOUBLE
+			std::vector<int64_t> ints;             // INT64
+			std::vector<size_t> offsets;           // STRING, rows + 1 entries
+			std::string blob;
+			std::vector<uint64_t> validity;        // bit i % 64 of word i / 64
+
+			bool valid(size_t row) const { return (validity[row / 64] >> (row % 64)) & 1; }
+			std::string string_at(size_t row) const {
+				return blob.substr(offsets[row], offsets[row + 1] - offsets[row]);
+			}
+		};
+
+		explicit JColumns(const std::vector<std::pair<std::string, Kind>>& fields);
+		JColumns(std::initializer_list<std::pair<std::string, Kind>> fields)
+			: JColumns(std::vector<std::pair<std::string, Kind>>(fields)) {}
+
+		// appends the rows of an array, throws std::runtime_error("NOT_ARRAY").
+		// Elements that are not objects are rows of nulls.
+		void append(const Json& rows);
+		// the same from JSON text, filling the columns while parsing: no nodes
+		// are built and unrequested members are skipped unparsed
+		void load(const std::string& text);
+		void clear();
+
+		size_t rows() const { return m_rows; }
+		size_t size() const { return m_columns.size(); }
+		const Column& operator[](size_t i) const { return m_columns[i]; }
+		// nullptr when no column has that name
+		const Column* find(const std::string& name) const;
+
+	private:
+		Column* column(const std::string& name);
+		void add_row();
+		void set_valid(Column& c, bool valid);
+		void set_number(Column& c, double v, const char* lexeme, size_t len);
+		void set_string(Column& c, const char* v, size_t len);
+		void set_null(Column& c);
 
+		std::vector<Column> m_columns;
+		size_t m_rows = 0;
+	};
+
+	// Bounded LRU cache of parsed documents keyed by a hash of the input
+	// text, for payloads that arrive again and again. Documents are kept
+	// frozen (see Json::freeze), so no caller can change one under the
+	// others. A hit compares the stored text before returning, so a
+	// collision costs only a parse. Each entry is charged its text plus the
+	// snapshot; the least recently used go first once max_bytes is exceeded.
+	// Safe to share between threads.
+	class JParseCache final {
+	public:
+		struct Stats {
+			size_t hits;
+			size_t misses;
+			size_t evictions;
+			size_t entries;
+			size_t bytes;
+		};
+
+		explicit JParseCache(size_t max_bytes = 16 << 20);
+		JParseCache(const JParseCache&) = delete;
+		JParseCache& operator=(const JParseCache&) = delete;
+		~JParseCache();
+
+		// Json::load(text).freeze(), shared by every hit on the same text.
+		// Only JView reads are free: JPointer, JPath, JSchema, JColumns,
+		// Json::diff and any change need a Json, and root().to_json()
+		// rebuilds the whole tree, most of the cost of a parse. Cache
+		// documents that are read through JView.
+		std::shared_ptr<const JSnapshot> load(const std::string& text);
+
+		void set_max_bytes(size_t max_bytes);
+		Stats stats() const;
+		void clear();
+
+	private:
+		struct State;                              // defined in ccjson.cpp
+
+		void evict(size_t max_bytes);
+
+		std::unique_ptr<State> m_state;
 	};
 
 	class JValue {
 		friend class Json;
+		friend class JDouble;                      // numbers compare across node kinds
+		friend class JRawNumber;
+		friend struct JNodeCache;
 	protected:
 		virtual Json::Jtype get_type()                         const = 0;
 		virtual bool equals(const JValue* rhs)                 const = 0;
 		virtual bool less(const JValue* rhs)                   const = 0;
 		virtual void dump(std::string& out)                    const = 0;
+		virtual size_t hash()                                  const = 0;
+		// called by every change to the node itself
+		void touch() {
+#ifdef CCJSON_NODE_CACHE
+			m_version = new_version();
+#endif
+		}
 		virtual double get_number()                            const;
+		virtual int64_t get_int64()                            const;
 		virtual bool get_bool()                                const;
 		virtual const std::string& get_string()                const;
 		virtual const Json::Jarray& get_array()                const;
@@ -118,6 +584,710 @@ namespace json {
 		virtual void set_value(Json::Jobject&& value);
 
 		virtual ~JValue() {}
+
+#ifdef CCJSON_NODE_CACHE
+		// drops cached hashes and text below this node that changes made
+		// through any handle made stale, once per outermost hash() or dump()
+		virtual void refresh() const {}
+		// versions are unique process wide, never reused by a node created
+		// at the address of a freed one
+		static uint64_t new_version();
+		mutable uint64_t m_version = new_version();
+#endif
+
+#ifdef CCJSON_SINGLE_THREADED
+		friend class JHandle;
+		long m_refs = 0;
+#endif
+	};
+
+#ifdef CCJSON_SINGLE_THREADED
+	inline JHandle::JHandle(JValue* p) noexcept : m_p(p) {
+		++p->m_refs;
+	}
+	inline JHandle::JHandle(const JHandle& rhs) noexcept : m_p(rhs.m_p) {
+		if(m_p)
+			++m_p->m_refs;
+	}
+	inline JHandle::~JHandle() {
+		if(m_p && --m_p->m_refs == 0)
+			delete m_p;
+	}
+	inline long JHandle::use_count() const noexcept {
+		return m_p ? m_p->m_refs : 0;
+	}
+#endif
+
+	// Binary snapshot written by Json::dump_binary. Every node is 8-byte
+	// aligned and starts with {uint32 type, uint32 n}:
+	//   JNULL, JBOOL(n = value), JNUMBER(+ double), JSTRING(n = length, + bytes '\0'),
+	//   JARRAY(n = count, + uint32 offset[n]),
+	//   JOBJECT(n = count, + {uint32 key, uint32 value}[n] sorted by key).
+	// Snapshots are trusted input: only the header is checked on open.
+	class JView final {
+	public:
+		JView() : m_base(nullptr), m_off(0) {}
+
+		bool valid() const { return m_base != nullptr; }
+		Json::Jtype get_type() const;
+
+		bool is_null()   const { return get_type() == Json::JNULL; }
+		bool is_number() const { return get_type() == Json::JNUMBER; }
+		bool is_bool()   const { return get_type() == Json::JBOOL; }
+		bool is_string() const { return get_type() == Json::JSTRING; }
+		bool is_array()  const { return get_type() == Json::JARRAY; }
+		bool is_object() const { return get_type() == Json::JOBJECT; }
+
+		double get_number() const;
+		bool   get_bool()   const;
+		std::string get_string() const { return std::string(string_data(), string_size()); }
+		const char* string_data() const;
+		size_t string_size() const;
+
+		// element count of an array, member count of an object
+		size_t size() const;
+		JView operator[](size_t i) const;
+		JView operator[](const std::string& key) const;
+		JView key(size_t i) const;
+		JView value(size_t i) const;
+		// binary search, returns an invalid view on a miss
+		JView find(const char* key, size_t len) const;
+		JView find(const std::string& key) const { return find(key.data(), key.size()); }
+		JView find(const char* key) const;
+
+		Json to_json() const;
+
+	private:
+		friend class JSnapshot;
+		JView(const char* base, uint32_t off) : m_base(base), m_off(off) {}
+		uint32_t word(size_t i) const;
+
+		const char* m_base;
+		uint32_t m_off;
+	};
+
+	class JSnapshot final {
+	public:
+		// maps the file read-only, pages are shared between processes
+		static JSnapshot open(const std::string& path);
+		explicit JSnapshot(std::string bytes);
+		JSnapshot(JSnapshot&& rhs) noexcept;
+		JSnapshot& operator=(JSnapshot&& rhs) noexcept;
+		JSnapshot(const JSnapshot&) = delete;
+		JSnapshot& operator=(const JSnapshot&) = delete;
+		~JSnapshot();
+
+		JView root() const;
+		size_t size() const { return m_size; }
+
+	private:
+		JSnapshot() : m_data(nullptr), m_size(0), m_mapped(false) {}
+		void check() const;
+		void release();
+
+		const char* m_data;
+		size_t m_size;
+		bool m_mapped;
+		std::string m_buffer;
+	};
+
+	// shared by Json::dump, JWriter and the binding layer
+	void dump_string(const std::string& value, std::string& out);
+	void dump_string(const char* value, size_t size, std::string& out);
+	void dump_number(double value, std::string& out);
+	void dump_int64(int64_t value, std::string& out);
+	void dump_uint64(uint64_t value, std::string& out);
+
+	// token level reader over the JParser grammar, used by the binding layer
+	class JReader final {
+	public:
+		explicit JReader(const char* in) : m_cur(in), m_depth(0), m_first(false) {}
+
+		// type of the next value, skips whitespace
+		Json::Jtype peek();
+		void read_null();
+		bool read_bool();
+		double read_number();
+		// a whole number in [lo, hi] read exactly, integer lexemes never pass
+		// through double; std::logic_error("PARSE_NUMBER_...") otherwise
+		int64_t read_int64(int64_t lo, int64_t hi);
+		uint64_t read_uint64(uint64_t hi);
+		void read_string(std::string& out);
+		Json read_value();
+		void skip_value();
+
+		// true while another element/member follows
+		void begin_array();
+		bool next_element();
+		void begin_object();
+		bool next_member(std::string& key);
+
+		// only whitespace may follow the root value
+		void finish();
+
+	private:
+		bool next(char close, const char* error);
+
+		const char* m_cur;
+		int m_depth;
+		bool m_first;
+	};
+
+	// an element of a root array (empty key) or a member of a root object
+	struct JElement {
+		std::string key;
+		Json value;
+	};
+
+	// Parses a root array or object an element at a time while pulling its
+	// text in chunks, so memory is bounded by the largest element rather than
+	// the input. A scalar root comes out as one element. Malformed input
+	// throws as Json::load does, possibly after earlier elements came out.
+	// See stream_elements for a coroutine range over it.
+	class JElementReader final {
+	public:
+		// fills buffer with at most size bytes and returns how many, 0 at the end
+		typedef size_t (*Source)(char* buffer, size_t size, void* user);
+
+		JElementReader(Source source, void* user, size_t chunk_size = 64 * 1024);
+		// a buffer the caller keeps alive
+		JElementReader(const char* data, size_t size);
+		// throws std::runtime_error("STREAM_OPEN_FAILED")
+		static JElementReader open(const std::string& path);
+		JElementReader(JElementReader&& rhs) noexcept;
+		JElementReader& operator=(JElementReader&& rhs) noexcept;
+		~JElementReader();
+
+		// JARRAY or JOBJECT, or the type of a scalar root
+		Json::Jtype type();
+		// false after the last element
+		bool next(JElement& out);
+
+	private:
+		struct State;                              // defined in ccjson.cpp
+
+		std::unique_ptr<State> m_state;
+	};
+
+#ifdef CCJSON_COROUTINES
+	// Input range over what a coroutine yields, resumed on each increment.
+	// An exception leaving the coroutine is rethrown from begin() or ++.
+	template <typename T>
+	class JGenerator final {
+	public:
+		struct promise_type {
+			T* current = nullptr;
+			std::exception_ptr error;
+
+			JGenerator get_return_object() {
+				return JGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+			}
+			std::suspend_always initial_suspend() const noexcept { return {}; }
+			std::suspend_always final_suspend() const noexcept { return {}; }
+			std::suspend_always yield_value(T& value) noexcept {
+				current = std::addressof(value);
+				return {};
+			}
+			std::suspend_always yield_value(T&& value) noexcept {
+				current = std::addressof(value);
+				return {};
+			}
+			void return_void() const noexcept {}
+			void unhandled_exception() { error = std::current_exception(); }
+		};
+
+		class iterator {
+		public:
+			using iterator_category = std::input_iterator_tag;
+			using difference_type = std::ptrdiff_t;
+			using value_type = T;
+			using reference = T&;
+			using pointer = T*;
+
+			iterator() = default;
+			explicit iterator(std::coroutine_handle<promise_type> h) : m_h(h) {}
+
+			T& operator*() const { return *m_h.promise().current; }
+			T* operator->() const { return m_h.promise().current; }
+			iterator& operator++() {
+				resume(m_h);
+				return *this;
+			}
+			void operator++(int) { ++*this; }
+			bool operator==(std::default_sentinel_t) const { return !m_h || m_h.done(); }
+
+		private:
+			std::coroutine_handle<promise_type> m_h;
+		};
+
+		JGenerator(JGenerator&& rhs) noexcept : m_h(rhs.m_h) { rhs.m_h = nullptr; }
+		JGenerator& operator=(JGenerator&& rhs) noexcept {
+			std::swap(m_h, rhs.m_h);
+			return *this;
+		}
+		~JGenerator() {
+			if(m_h)
+				m_h.destroy();
+		}
+
+		iterator begin() {
+			resume(m_h);
+			return iterator(m_h);
+		}
+		std::default_sentinel_t end() const noexcept { return {}; }
+
+	private:
+		explicit JGenerator(std::coroutine_handle<promise_type> h) : m_h(h) {}
+
+		static void resume(std::coroutine_handle<promise_type> h) {
+			h.resume();
+			if(h.promise().error)
+				std::rethrow_exception(h.promise().error);
+		}
+
+		std::coroutine_handle<promise_type> m_h;
+	};
+
+	// yields each element as soon as it is parsed, e.g.
+	//   for(JElement& e : stream_elements(JElementReader::open("rows.json")))
+	inline JGenerator<JElement> stream_elements(JElementReader reader) {
+		JElement e;
+		while(reader.next(e))
+			co_yield e;
+	}
+#endif
+
+	// Streaming writer, the counterpart of JReader: emits text straight into a
+	// string or through a sink without building Json nodes, escaping and
+	// formatting numbers as dump does. Debug builds assert on calls that would
+	// produce malformed JSON: a member without a key, a mismatched end, or a
+	// second root value.
+	class JWriter final {
+	public:
+		typedef void (*Sink)(const char* data, size_t size, void* user);
+
+		explicit JWriter(std::string& out);
+		// hands over text in chunks of about buffer_size bytes, and on flush
+		JWriter(Sink sink, void* user, size_t buffer_size = 4096);
+		JWriter(const JWriter&) = delete;
+		JWriter& operator=(const JWriter&) = delete;
+		~JWriter();
+
+		JWriter& begin_object();
+		JWriter& end_object();
+		JWriter& begin_array();
+		JWriter& end_array();
+		JWriter& key(const char* name, size_t len);
+		JWriter& key(const char* name);
+		JWriter& key(const std::string& name) { return key(name.data(), name.size()); }
+
+		JWriter& null();
+		JWriter& value(bool v);
+		JWriter& value(double v);
+		// integers are written exactly, also beyond 2^53
+		JWriter& value(int64_t v);
+		JWriter& value(uint64_t v);
+		template <typename T>
+		typename std::enable_if<std::is_floating_point<T>::value, JWriter&>::type
+		value(T v) { return value(static_cast<double>(v)); }
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value, JWriter&>::type
+		value(T v) { return value(static_cast<int64_t>(v)); }
+		template <typename T>
+		typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value && !std::is_same<T, bool>::value, JWriter&>::type
+		value(T v) { return value(static_cast<uint64_t>(v)); }
+		JWriter& value(const char* v, size_t len);
+		JWriter& value(const char* v);
+		JWriter& value(const std::string& v) { return value(v.data(), v.size()); }
+		JWriter& value(const Json& v);
+
+		// a complete root value has been written
+		bool done() const { return m_done; }
+		void flush();
+
+	private:
+		void separate();
+		void wrote();
+
+		Sink m_sink;
+		void* m_user;
+		size_t m_limit;
+		std::string m_buffer;      // sink mode only
+		std::string& m_out;
+		std::string m_open;        // '[' or '{' per open container
+		bool m_first;              // no comma before the next value or key
+		bool m_after_key;
+		bool m_done;
+	};
+
+	// Binding between C++ types and JSON text without building Json nodes.
+	// Structs opt in with CCJSON_FIELDS(member, ...) in their body; numbers,
+	// bool, std::string, std::vector, std::map<std::string, T> and Json
+	// are supported out of the box.
+	template <typename T, typename Enable = void>
+	struct JBind {
+		struct Reader {
+			JReader& in;
+			const std::string& key;
+			bool found;
+
+			template <typename M>
+			void operator()(const char* name, M& member) {
+				if(!found && key == name) {
+					found = true;
+					JBind<M>::read(in, member);
+				}
+			}
+		};
+		struct Writer {
+			std::string& out;
+			bool first;
+
+			template <typename M>
+			void operator()(const char* name, const M& member) {
+				if(!first)
+					out += ',';
+				first = false;
+				dump_string(name, out);
+				out += ':';
+				JBind<M>::write(member, out);
+			}
+		};
+
+		static void read(JReader& in, T& v) {
+			std::string key;
+			in.begin_object();
+			while(in.next_member(key)) {
+				Reader reader { in, key, false };
+				v.json_fields(reader);
+				if(!reader.found)
+					in.skip_value();
+			}
+		}
+		static void write(const T& v, std::string& out) {
+			out += '{';
+			Writer writer { out, true };
+			v.json_fields(writer);
+			out += '}';
+		}
+	};
+
+	template <typename T>
+	struct JBind<T, typename std::enable_if<std::is_floating_point<T>::value>::type> {
+		static void read(JReader& in, T& v) { v = static_cast<T>(in.read_number()); }
+		static void write(T v, std::string& out) { dump_number(static_cast<double>(v), out); }
+	};
+
+	// integers are read and written exactly, never through double
+	template <typename T>
+	struct JBind<T, typename std::enable_if<std::is_integral<T>::value>::type> {
+		static void read(JReader& in, T& v) { read(in, v, std::is_signed<T>()); }
+		static void write(T v, std::string& out) { write(v, out, std::is_signed<T>()); }
+
+	private:
+		static void read(JReader& in, T& v, std::true_type) {
+			v = static_cast<T>(in.read_int64(std::numeric_limits<T>::min(), std::numeric_limits<T>::max()));
+		}
+		static void read(JReader& in, T& v, std::false_type) {
+			v = static_cast<T>(in.read_uint64(std::numeric_limits<T>::max()));
+		}
+		static void write(T v, std::string& out, std::true_type) { dump_int64(v, out); }
+		static void write(T v, std::string& out, std::false_type) { dump_uint64(v, out); }
+	};
+
+	template <>
+	struct JBind<bool> {
+		static void read(JReader& in, bool& v) { v = in.read_bool(); }
+		static void write(bool v, std::string& out) { out += v ? "true" : "false"; }
+	};
+
+	template <>
+	struct JBind<std::string> {
+		static void read(JReader& in, std::string& v) { in.read_string(v); }
+		static void write(const std::string& v, std::string& out) { dump_string(v, out); }
+	};
+
+	template <>
+	struct JBind<Json> {
+		static void read(JReader& in, Json& v) { v = in.read_value(); }
+		static void write(const Json& v, std::string& out) { v.dump(out); }
+	};
+
+	template <typename T, typename A>
+	struct JBind<std::vector<T, A>> {
+		static void read(JReader& in, std::vector<T, A>& v) {
+			v.clear();
+			in.begin_array();
+			while(in.next_element()) {
+				v.emplace_back();
+				JBind<T>::read(in, v.back());
+			}
+		}
+		static void write(const std::vector<T, A>& v, std::string& out) {
+			out += '[';
+			for(size_t i = 0; i < v.size(); ++i) {
+				if(i > 0)
+					out += ',';
+				JBind<T>::write(v[i], out);
+			}
+			out += ']';
+		}
+	};
+
+	template <typename T, typename C, typename A>
+	struct JBind<std::map<std::string, T, C, A>> {
+		static void read(JReader& in, std::map<std::string, T, C, A>& v) {
+			v.clear();
+			std::string key;
+			in.begin_object();
+			while(in.next_member(key))
+				JBind<T>::read(in, v[key]);
+		}
+		static void write(const std::map<std::string, T, C, A>& v, std::string& out) {
+			out += '{';
+			for(auto iter = v.cbegin(); iter != v.cend(); ++iter) {
+				if(iter != v.cbegin())
+					out += ',';
+				dump_string(iter->first, out);
+				out += ':';
+				JBind<T>::write(iter->second, out);
+			}
+			out += '}';
+		}
+	};
+
+	template <typename T>
+	void load(const std::string& in, T& out) {
+		JReader reader(in.c_str());
+		JBind<T>::read(reader, out);
+		reader.finish();
+	}
+
+	template <typename T>
+	void dump(const T& value, std::string& out) {
+		JBind<T>::write(value, out);
+	}
+
+	template <typename T>
+	std::string dump(const T& value) {
+		std::string out;
+		JBind<T>::write(value, out);
+		return out;
+	}
+
+#if __cplusplus >= 201402L
+	// Compile time check of the Json::load grammar, used by CCJSON_LITERAL.
+	// Number range is not checked: 1e999 passes here and throws
+	// PARSE_NUMBER_TOO_BIG on first use.
+	class JLiteral final {
+	public:
+		static constexpr bool valid(const char* text) {
+			JLiteral c { text };
+			c.whitespace();
+			if(!c.value(0))
+				return false;
+			c.whitespace();
+			return *c.m_cur == '\0';
+		}
+
+	private:
+		constexpr explicit JLiteral(const char* text) : m_cur(text) {}
+
+		static constexpr bool digit(char ch) { return ch >= '0' && ch <= '9'; }
+		static constexpr bool hex(char ch) {
+			return digit(ch) || (ch >= 'a' && ch <= 'f') || (ch >= 'A' && ch <= 'F');
+		}
+		constexpr void whitespace() {
+			while(*m_cur == ' ' || *m_cur == '\t' || *m_cur == '\n' || *m_cur == '\r')
+				++m_cur;
+		}
+		constexpr bool word(const char* w) {
+			for(; *w; ++w, ++m_cur) {
+				if(*m_cur != *w)
+					return false;
+			}
+			return true;
+		}
+		constexpr bool value(int depth) {
+			if(depth > 200)                         // Json::load's nesting limit
+				return false;
+			switch(*m_cur) {
+				case 'n':  return word("null");
+				case 't':  return word("true");
+				case 'f':  return word("false");
+				case '\"': return string();
+				case '[':  return array(depth);
+				case '{':  return object(depth);
+				default:   return number();
+			}
+		}
+		constexpr bool number() {
+			if(*m_cur == '-')
+				++m_cur;
+			if(*m_cur == '0') {
+				if(digit(*++m_cur))
+					return false;
+			} else {
+				if(*m_cur < '1' || *m_cur > '9')
+					return false;
+				while(digit(*++m_cur))
+					;
+			}
+			if(*m_cur == '.') {
+				if(!digit(*++m_cur))
+					return false;
+				while(digit(*++m_cur))
+					;
+			}
+			if(*m_cur == 'e' || *m_cur == 'E') {
+				++m_cur;
+				if(*m_cur == '+' || *m_cur == '-')
+					++m_cur;
+				if(!digit(*m_cur))
+					return false;
+				while(digit(*++m_cur))
+					;
+			}
+			return true;
+		}
+		constexpr bool hex4(unsigned& u) {
+			u = 0;
+			for(int i = 0; i < 4; ++i, ++m_cur) {
+				char ch = *m_cur;
+				if(!hex(ch))
+					return false;
+				u = u * 16 + (digit(ch) ? ch - '0' : (ch | 0x20) - 'a' + 10);
+			}
+			return true;
+		}
+		constexpr bool string() {
+			for(++m_cur;; ) {
+				unsigned char ch = *m_cur++;
+				if(ch == '\"')
+					return true;
+				if(ch < 0x20)
+					return false;                   // control character or end of text
+				if(ch != '\\')
+					continue;
+				switch(*m_cur++) {
+					case '\"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+						break;
+					case 'u': {
+						unsigned u = 0, u2 = 0;
+						if(!hex4(u))
+							return false;
+						if(u >= 0xD800 && u <= 0xDBFF) {
+							if(*m_cur++ != '\\' || *m_cur++ != 'u' || !hex4(u2) || u2 < 0xDC00 || u2 > 0xDFFF)
+								return false;
+						}
+						break;
+					}
+					default:
+						return false;
+				}
+			}
+		}
+		constexpr bool array(int depth) {
+			++m_cur;
+			whitespace();
+			if(*m_cur == ']') {
+				++m_cur;
+				return true;
+			}
+			for(;;) {
+				if(!value(depth + 1))
+					return false;
+				whitespace();
+				if(*m_cur == ']') {
+					++m_cur;
+					return true;
+				}
+				if(*m_cur++ != ',')
+					return false;
+				whitespace();
+			}
+		}
+		constexpr bool object(int depth) {
+			++m_cur;
+			whitespace();
+			if(*m_cur == '}') {
+				++m_cur;
+				return true;
+			}
+			for(;;) {
+				if(*m_cur != '\"' || !string())
+					return false;
+				whitespace();
+				if(*m_cur++ != ':')
+					return false;
+				whitespace();
+				if(!value(depth + 1))
+					return false;
+				whitespace();
+				if(*m_cur == '}') {
+					++m_cur;
+					return true;
+				}
+				if(*m_cur++ != ',')
+					return false;
+				whitespace();
+			}
+		}
+
+		const char* m_cur;
+	};
+#endif
+}
+
+#define CCJSON_EXPAND(x) x
+#define CCJSON_FE_1(m, x) m(x)
+#define CCJSON_FE_2(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_1(m, __VA_ARGS__))
+#define CCJSON_FE_3(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_2(m, __VA_ARGS__))
+#define CCJSON_FE_4(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_3(m, __VA_ARGS__))
+#define CCJSON_FE_5(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_4(m, __VA_ARGS__))
+#define CCJSON_FE_6(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_5(m, __VA_ARGS__))
+#define CCJSON_FE_7(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_6(m, __VA_ARGS__))
+#define CCJSON_FE_8(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_7(m, __VA_ARGS__))
+#define CCJSON_FE_9(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_8(m, __VA_ARGS__))
+#define CCJSON_FE_10(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_9(m, __VA_ARGS__))
+#define CCJSON_FE_11(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_10(m, __VA_ARGS__))
+#define CCJSON_FE_12(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_11(m, __VA_ARGS__))
+#define CCJSON_FE_13(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_12(m, __VA_ARGS__))
+#define CCJSON_FE_14(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_13(m, __VA_ARGS__))
+#define CCJSON_FE_15(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_14(m, __VA_ARGS__))
+#define CCJSON_FE_16(m, x, ...) m(x) CCJSON_EXPAND(CCJSON_FE_15(m, __VA_ARGS__))
+#define CCJSON_GET_FE(_1,_2,_3,_4,_5,_6,_7,_8,_9,_10,_11,_12,_13,_14,_15,_16, NAME, ...) NAME
+#define CCJSON_FOR_EACH(m, ...) CCJSON_EXPAND(CCJSON_GET_FE(__VA_ARGS__, CCJSON_FE_16, CCJSON_FE_15, CCJSON_FE_14, CCJSON_FE_13, CCJSON_FE_12, CCJSON_FE_11, CCJSON_FE_10, CCJSON_FE_9, CCJSON_FE_8, CCJSON_FE_7, CCJSON_FE_6, CCJSON_FE_5, CCJSON_FE_4, CCJSON_FE_3, CCJSON_FE_2, CCJSON_FE_1)(m, __VA_ARGS__))
+
+#define CCJSON_FIELD(m) f(#m, m);
+// lists the members bound by JBind, up to 16
+#define CCJSON_FIELDS(...) \
+	template <typename F> void json_fields(F& f) { CCJSON_FOR_EACH(CCJSON_FIELD, __VA_ARGS__) } \
+	template <typename F> void json_fields(F& f) const { CCJSON_FOR_EACH(CCJSON_FIELD, __VA_ARGS__) }
+
+// A document from a JSON string literal: malformed text fails the build
+// (C++14 and later). The literal is parsed and frozen once on first use;
+// every evaluation rebuilds a fresh tree from the snapshot, so changing one
+// result never reaches the next.
+#if __cplusplus >= 201402L
+#define CCJSON_LITERAL(text) \
+	([]() -> ::json::Json { \
+		static_assert(::json::JLiteral::valid(text), "malformed JSON literal"); \
+		static const ::json::JSnapshot frozen = ::json::Json::load(text).freeze(); \
+		return frozen.root().to_json(); \
+	}())
+#else
+#define CCJSON_LITERAL(text) \
+	([]() -> ::json::Json { \
+		static const ::json::JSnapshot frozen = ::json::Json::load(text).freeze(); \
+		return frozen.root().to_json(); \
+	}())
+#endif
+
+namespace std {
+	template <>
+	struct hash<json::Json> {
+		size_t operator()(const json::Json& v) const { return v.hash(); }
 	};
 }
 
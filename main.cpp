@@ -1,8 +1,36 @@
 #include "ccjson.h"
 #include "minunit.h"
 #include <limits>
+#include <atomic>
+#include <thread>
+#include <new>
+#include <cstdlib>
+#include <cstdio>
 using namespace json;
 
+// counts every heap allocation so tests can check what an operation costs;
+// atomic because the threaded tests allocate concurrently
+static std::atomic<size_t> heap_allocations(0);
+static std::atomic<size_t> heap_bytes(0);
+static std::atomic<size_t> heap_frees(0);
+
+void* operator new(size_t size) {
+    heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    heap_bytes.fetch_add(size, std::memory_order_relaxed);
+    if(void* p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+#if defined(__GNUC__) && __GNUC__ >= 11
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"  // operator new above uses malloc
+#endif
+void operator delete(void* p) noexcept {
+    if(p)
+        heap_frees.fetch_add(1, std::memory_order_relaxed);
+    free(p);
+}
+void operator delete(void* p, size_t) noexcept { operator delete(p); }
+
 static void TEST_STRING(std::string expect, std::string json)
 {
     auto res = Json::load(json);
@@ -132,6 +160,9 @@ MU_TEST(test_array_parse)
 }
 #include <chrono>
 #include <iostream>
+#include <algorithm>
+#include <set>
+#include <unordered_set>
 MU_TEST(test_object_parse2_long_string)
 {
 	{
@@ -233,6 +264,1397 @@ MU_TEST(test_stringly) {
     TEST_STRINGLING("true");
 }
 
+MU_TEST(test_binary_snapshot)
+{
+    auto doc = Json::load("{\"name\":\"ccjson\",\"list\":[1,true,null,\"x\"],"
+                          "\"nested\":{\"a\":1.5,\"b\":[]},\"z\":false}");
+    Json::Jarray shared { doc, doc };
+    std::string bytes = Json(shared).dump_binary();
+
+    JSnapshot snapshot(bytes);
+    JView root = snapshot.root();
+    mu_check(root.is_array());
+    mu_assert_int_eq(2, (int)root.size());
+
+    JView v = root[1];
+    mu_check(v["name"].get_string() == "ccjson");
+    mu_assert_double_eq(1.5, v["nested"]["a"].get_number());
+    mu_check(v["list"][1].get_bool());
+    mu_check(v["list"][2].is_null());
+    mu_check(!v.find("missing").valid());
+    mu_check(!v["z"].get_bool());
+    mu_check(root.to_json() == Json(shared));
+
+    // shared subtrees are written once
+    mu_check(bytes.size() < Json(Json::Jarray { doc }).dump_binary().size() * 2);
+
+    const char* path = "snapshot_test.bin";
+    FILE* f = fopen(path, "wb");
+    fwrite(bytes.data(), 1, bytes.size(), f);
+    fclose(f);
+    {
+        JSnapshot mapped = JSnapshot::open(path);
+        mu_check(mapped.root()[0]["nested"]["b"].is_array());
+        mu_check(mapped.root().to_json() == Json(shared));
+    }
+    remove(path);
+
+    bool thrown = false;
+    try {
+        JSnapshot bad(std::string("not a snapshot"));
+    } catch(const std::logic_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+}
+
+MU_TEST(test_json_pointer)
+{
+    auto doc = Json::load("{\"foo\":[\"bar\",\"baz\"],\"\":0,\"a/b\":1,\"m~n\":8,"
+                          "\"deep\":{\"list\":[{\"c\":true}]}}");
+    mu_check(JPointer("").get(doc) == doc);
+    mu_assert_string_eq("baz", JPointer("/foo/1").get(doc).get_string().c_str());
+    mu_assert_double_eq(0, JPointer("/").get(doc).get_number());
+    mu_assert_double_eq(1, JPointer("/a~1b").get(doc).get_number());
+    mu_assert_double_eq(8, JPointer("/m~0n").get(doc).get_number());
+    mu_check(JPointer("/deep/list/0/c").get(doc).get_bool());
+    std::string path = JPointer("/a~1b").to_string();
+    mu_assert_string_eq("/a~1b", path.c_str());
+
+    mu_check(JPointer("/foo/2").find(doc) == nullptr);
+    mu_check(JPointer("/foo/01").find(doc) == nullptr);
+    mu_check(JPointer("/missing/x").find(doc) == nullptr);
+    mu_check(JPointer("/deep/list/0/c/x").find(doc) == nullptr);
+
+    JPointer("/deep/list/0/c").set(doc, false);
+    mu_check(!doc["deep"]["list"][0]["c"].get_bool());
+    JPointer("/deep/new").set(doc, "v");
+    mu_assert_string_eq("v", doc["deep"]["new"].get_string().c_str());
+    JPointer("/foo/-").set(doc, 3.0);
+    mu_assert_int_eq(3, (int)doc["foo"].get_array().size());
+
+    bool thrown = false;
+    try {
+        JPointer("/missing/x").set(doc, 1.0);
+    } catch(const std::out_of_range&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+
+    thrown = false;
+    try {
+        JPointer p("a/~2");
+    } catch(const std::logic_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+}
+
+static std::string path_dump(const std::vector<const Json*>& matches) {
+    std::string out;
+    for(const Json* m : matches)
+        out += m->dump() + " ";
+    return out;
+}
+
+MU_TEST(test_json_path)
+{
+    Json store = Json::load(R"({"store": {
+        "book": [
+            {"title": "A", "price": 8.5, "tags": ["x"]},
+            {"title": "B", "price": 12.25, "isbn": "0-1"},
+            {"title": "C", "price": 8.75, "isbn": "0-2"},
+            {"title": "D", "price": 22.5}
+        ],
+        "bicycle": {"color": "red", "price": 19.5},
+        "a b": 1
+    }})");
+    auto query = [&](const char* expr) { return path_dump(JPath(expr).find(store)); };
+    mu_check(query("$.store.book[*].title") == "\"A\" \"B\" \"C\" \"D\" ");
+    mu_check(query("$['store']['bicycle'].color") == "\"red\" ");
+    mu_check(query("$.store['a b']") == "1 ");
+    mu_check(query("$..price") == "19.5 8.5 12.25 8.75 22.5 ");
+    mu_check(query("$.store.book[-1].title") == "\"D\" ");
+    mu_check(query("$.store.book[1:3].title") == "\"B\" \"C\" ");
+    mu_check(query("$.store.book[::-2].title") == "\"D\" \"B\" ");
+    mu_check(query("$.store.book[:-3].title") == "\"A\" ");
+    mu_check(query("$.store.book[?(@.isbn)].title") == "\"B\" \"C\" ");
+    mu_check(query("$.store.book[?(@.price < 10)].title") == "\"A\" \"C\" ");
+    mu_check(query("$..book[?(@.title == 'D')].price") == "22.5 ");
+    mu_check(query("$..[?(@.tags[0] != null)].title") == "\"A\" ");
+    mu_check(query("$.store.book[?(@.title >= 3)]") == "");
+    mu_check(query("$.store.*.color") == "\"red\" ");
+    mu_check(query("$..tags.*") == "\"x\" ");
+    mu_check(query("$.missing[0]") == "");
+    mu_check(JPath("$").find(store).front() == &store);
+
+    // matches point into the document
+    const Json* first = JPath("$.store.book[0]").find(store).front();
+    mu_check(first == &store["store"]["book"][0]);
+
+    const char* bad[][2] = {
+        { "store", "PATH_MISS_ROOT" },
+        { "$.", "PATH_INVALID_SYNTAX" },
+        { "$[1", "PATH_INVALID_SYNTAX" },
+        { "$['a]", "PATH_INVALID_SYNTAX" },
+        { "$[::0]", "PATH_INVALID_SLICE" },
+        { "$[?(@.a == [1])]", "PATH_INVALID_FILTER" },
+    };
+    for(auto& c : bad) {
+        std::string code;
+        try {
+            JPath p(c[0]);
+        } catch(std::logic_error& e) {
+            code = e.what();
+        }
+        mu_check(code == c[1]);
+    }
+
+    std::vector<Json> docs;
+    for(int i = 0; i < 1000; ++i)
+        docs.push_back(Json::load("{\"rows\":[{\"v\":" + std::to_string(i) + "},{\"v\":-1}]}"));
+    JPath positive("$.rows[?(@.v > 0)].v");
+    std::vector<std::vector<const Json*>> results;
+    positive.find_all(docs, results, 4);
+    mu_assert_int_eq(1000, (int)results.size());
+    mu_check(results[0].empty());
+    mu_check(results[999].size() == 1 && results[999][0] == &docs[999]["rows"][0]["v"]);
+    size_t before = heap_allocations;
+    positive.find_all(docs, results, 1);                   // reuses the result buffers
+    mu_assert_int_eq(0, (int)(heap_allocations - before));
+}
+
+MU_TEST(test_projection_parse)
+{
+    std::string ins("{\"id\":7,\"skip\":{\"s\":\"a]}\\\"b\",\"n\":[1,[2,{}]]},"
+                    "\"user\":{\"name\":\"x\",\"bio\":\"long\",\"tags\":[\"a\",\"b\"]},"
+                    "\"list\":[{\"v\":0},{\"v\":1},{\"v\":2}],\"num\":-1.5e3}");
+    JProjection projection { JPointer("/id"), JPointer("/user/name"), JPointer("/user/tags"),
+                             JPointer("/list/1/v"), JPointer("/num/x") };
+    auto res = Json::load(ins, projection);
+
+    mu_assert_int_eq(3, (int)res.get_object().size());
+    mu_assert_double_eq(7, res["id"].get_number());
+    mu_assert_string_eq("x", res["user"]["name"].get_string().c_str());
+    mu_assert_int_eq(2, (int)res["user"]["tags"].get_array().size());
+    mu_check(JPointer("/user/bio").find(res) == nullptr);
+    mu_check(JPointer("/skip").find(res) == nullptr);
+    mu_check(JPointer("/num").find(res) == nullptr);
+
+    // skipped elements before a selected index are kept as null
+    mu_assert_int_eq(2, (int)res["list"].get_array().size());
+    mu_check(res["list"][0].is_null());
+    mu_assert_double_eq(1, res["list"][1]["v"].get_number());
+
+    mu_check(Json::load(ins, { JPointer("") }) == Json::load(ins));
+    mu_check(Json::load(ins, { JPointer("/missing") }).get_object().empty());
+
+    bool thrown = false;
+    try {
+        Json::load("{\"a\":1,\"skip\":[1,{\"x\":2]}", { JPointer("/a") });
+    } catch(const std::logic_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+
+    // skipped values are held to the full grammar, with the codes of a plain load
+    const char* malformed[] = { "{\"a\":1,\"b\":nonsense}", "{\"a\":1,\"b\":[1,tru]}",
+                                "{\"a\":1,\"b\":{\"c\" 2}}", "{\"a\":1,\"b\":[01]}",
+                                "{\"a\":1,\"b\":\"\\x\"}", "{\"a\":1,\"b\":[1 2]}",
+                                "{\"a\":1,\"b\":1e999}", "{\"a\":1,\"b\":{1:2}}" };
+    for(const char* text : malformed) {
+        std::string plain, projected;
+        try {
+            Json::load(text);
+        } catch(const std::logic_error& e) {
+            plain = e.what();
+        }
+        try {
+            Json::load(text, { JPointer("/a") });
+        } catch(const std::logic_error& e) {
+            projected = e.what();
+        }
+        mu_check(!plain.empty() && projected == plain);
+    }
+}
+
+MU_TEST(test_json_patch)
+{
+    auto doc = Json::load("{\"a\":{\"b\":[1,2,3]},\"c\":\"x\",\"keep\":{\"big\":[true]}}");
+    Json before = doc;
+    std::string original = doc.dump();
+
+    doc.apply_patch(Json::load("["
+        "{\"op\":\"add\",\"path\":\"/a/b/1\",\"value\":9},"
+        "{\"op\":\"add\",\"path\":\"/a/b/-\",\"value\":4},"
+        "{\"op\":\"remove\",\"path\":\"/a/b/0\"},"
+        "{\"op\":\"replace\",\"path\":\"/c\",\"value\":\"y\"},"
+        "{\"op\":\"copy\",\"from\":\"/c\",\"path\":\"/d\"},"
+        "{\"op\":\"move\",\"from\":\"/d\",\"path\":\"/a/e\"},"
+        "{\"op\":\"test\",\"path\":\"/a/e\",\"value\":\"y\"}]"));
+    std::string patched = doc.dump();
+    mu_assert_string_eq("{\"a\":{\"b\":[9,2,3,4],\"e\":\"y\"},\"c\":\"y\",\"keep\":{\"big\":[true]}}",
+                        patched.c_str());
+
+    // shared nodes are copied on the touched path only
+    mu_check(original == before.dump());
+    mu_check(&before["keep"].get_object() == &doc["keep"].get_object());
+
+    // a failing patch leaves the document unchanged
+    bool thrown = false;
+    try {
+        doc.apply_patch(Json::load("["
+            "{\"op\":\"add\",\"path\":\"/a/b/-\",\"value\":5},"
+            "{\"op\":\"remove\",\"path\":\"/c\"},"
+            "{\"op\":\"add\",\"path\":\"/keep/big/0\",\"value\":false},"
+            "{\"op\":\"test\",\"path\":\"/a/e\",\"value\":\"z\"}]"));
+    } catch(const std::logic_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+    mu_check(patched == doc.dump());
+
+    auto target = Json::load("{\"title\":\"Goodbye!\",\"author\":{\"givenName\":\"John\","
+                             "\"familyName\":\"Doe\"},\"tags\":[\"example\",\"sample\"]}");
+    target.merge_patch(Json::load("{\"title\":\"Hello!\",\"phoneNumber\":\"+01-123-456-7890\","
+                                  "\"author\":{\"familyName\":null},\"tags\":[\"example\"],"
+                                  "\"new\":{\"x\":null,\"y\":1}}"));
+    std::string merged = target.dump();
+    mu_assert_string_eq("{\"author\":{\"givenName\":\"John\"},\"new\":{\"y\":1},"
+                        "\"phoneNumber\":\"+01-123-456-7890\",\"tags\":[\"example\"],\"title\":\"Hello!\"}",
+                        merged.c_str());
+}
+
+static void TEST_DIFF(const char* from, const char* to, size_t ops) {
+    auto a = Json::load(from);
+    auto b = Json::load(to);
+    auto patch = Json::diff(a, b);
+    mu_assert_int_eq((int)ops, (int)patch.get_array().size());
+    a.apply_patch(patch);
+    mu_check(a == b);
+}
+
+MU_TEST(test_json_diff)
+{
+    TEST_DIFF("1", "1", 0);
+    TEST_DIFF("1", "\"x\"", 1);
+    TEST_DIFF("{\"a\":1,\"b\":2,\"c\":3}", "{\"b\":2,\"c\":4,\"d\":5}", 3);
+    TEST_DIFF("{\"a/b\":{\"m~n\":[1]}}", "{\"a/b\":{\"m~n\":[1,2]}}", 1);
+    TEST_DIFF("[1,2,3,4,5]", "[2,3,4,5,6]", 2);
+    TEST_DIFF("[1,2,3]", "[0,1,2,3]", 1);
+    TEST_DIFF("[1,2,3]", "[]", 3);
+    TEST_DIFF("[]", "[1,2]", 2);
+    TEST_DIFF("[{\"id\":1,\"v\":true},7,{\"id\":2}]", "[{\"id\":1,\"v\":false},{\"id\":2,\"x\":0}]", 3);
+
+    // unchanged subtrees shared between versions are never compared
+    auto v1 = Json::load("{\"big\":[1,2,3],\"n\":1}");
+    Json v2 = v1;
+    JPointer("/n").set(v2, 2.0);
+    auto patch = Json::diff(v1, v2);
+    mu_assert_int_eq(1, (int)patch.get_array().size());
+    mu_assert_string_eq("/n", patch[0]["path"].get_string().c_str());
+    mu_check(&v1["big"].get_array() == &v2["big"].get_array());
+}
+
+// serializes without the dump cache: JWriter walks containers itself
+static std::string uncached_dump(const Json& doc) {
+    std::string out;
+    JWriter(out).value(doc);
+    return out;
+}
+
+MU_TEST(test_incremental_dump)
+{
+    Json state = Json::load("{\"rows\": [], \"meta\": {\"version\": 1, \"tags\": [\"a\"]}}");
+    for(int i = 0; i < 100; ++i)
+        state["rows"].push_back(Json::load("{\"id\": " + std::to_string(i) + ", \"v\": [1, 2, {\"x\": null}]}"));
+    mu_check(state.dump() == uncached_dump(state));
+    mu_check(state.dump() == uncached_dump(state));
+
+    state["rows"][42]["v"][2]["x"] = Json("changed");
+    mu_check(state.dump() == uncached_dump(state));
+    state["meta"]["version"].set_value(2.0);
+    mu_check(state.dump() == uncached_dump(state));
+    state["meta"]["tags"].push_back(Json("b"));
+    mu_check(state.dump() == uncached_dump(state));
+    JPointer("/rows/7/id").set(state, Json("seven"));
+    mu_check(state.dump() == uncached_dump(state));
+    state.apply_patch(Json::load("[{\"op\": \"remove\", \"path\": \"/rows/0\"}]"));
+    mu_check(state.dump() == uncached_dump(state));
+    state.merge_patch(Json::load("{\"meta\": {\"tags\": null, \"new\": true}}"));
+    mu_check(state.dump() == uncached_dump(state));
+    state["meta"].insert_or_assign("version", Json(3.0));
+    mu_check(state.dump() == uncached_dump(state));
+    mu_check(state["meta"].dump() == "{\"new\":true,\"version\":3}");
+    mu_check(state["rows"][41]["v"].dump() == "[1,2,{\"x\":\"changed\"}]");
+
+    // changes that bypass the cached parents: a reference held across a
+    // dump, a copied child handle, and JPointer lookups
+    Json& meta = state["meta"];
+    mu_check(state.dump() == uncached_dump(state));
+    meta.insert_or_assign("held", Json(1.0));
+    mu_check(state.dump() == uncached_dump(state));
+    meta["held"].set_value(2.0);
+    mu_check(state.dump() == uncached_dump(state));
+    Json rows = state["rows"];
+    rows.push_back(Json("copied"));
+    mu_check(state.dump() == uncached_dump(state));
+    rows[0]["v"].push_back(Json(4.0));
+    mu_check(rows.dump() == uncached_dump(rows));            // child first, then its parent
+    mu_check(state.dump() == uncached_dump(state));
+    JPointer("/meta/version").find(state)->set_value(5.0);
+    mu_check(state.dump() == uncached_dump(state));
+    JPointer("/rows/1/v").get(state) = Json("replaced");
+    mu_check(state.dump() == uncached_dump(state));
+    mu_check(state["rows"][1].dump() == "{\"id\":2,\"v\":\"replaced\"}");
+    // a child replaced by a new node, likely at the freed one's address
+    Json doc = Json::load("{\"a\":1,\"b\":2}");
+    Json& a = doc["a"];
+    doc.dump();
+    a = Json();
+    a = Json(7.0);
+    mu_check(doc.dump() == "{\"a\":7,\"b\":2}");
+    *JPointer("/a").find(doc) = Json();
+    *JPointer("/a").find(doc) = Json(8.0);
+    mu_check(doc.dump() == "{\"a\":8,\"b\":2}");
+}
+
+MU_TEST(test_raw_numbers)
+{
+    std::string text = "{\"big\":12345678901234567890,\"e\":1E+2,\"n\":[0.1,7],\"neg\":-0.0,\"pi\":3.14159,\"tiny\":1e-400}";
+    Json doc = Json::load(text, PARSE_RAW_NUMBERS);
+    mu_check(doc.dump() == text);                            // verbatim
+    mu_check(Json::load(text).dump() != text);
+    mu_check(doc["pi"].is_number() && doc["pi"].get_number() == 3.14159);
+    mu_check(doc["e"].get_number() == 100 && doc["e"].get_int64() == 100);
+    mu_check(doc["n"][1].get_int64() == 7);
+    mu_check(doc["tiny"].get_number() == 0);
+
+    // compares, orders and hashes as the plain number
+    mu_check(doc["n"][0] == Json(0.1) && Json(0.1) == doc["n"][0]);
+    mu_check(doc["n"][0] < doc["n"][1] && Json(0.05) < doc["n"][0]);
+    mu_check(doc["e"].hash() == Json(100.0).hash());
+    mu_check(Json::load(text, PARSE_RAW_NUMBERS) == doc);
+
+    Json exact = Json::load("[9007199254740993, -9223372036854775808]", PARSE_RAW_NUMBERS);
+    mu_check(exact[0].get_int64() == 9007199254740993LL);
+    mu_check(exact[1].get_int64() == INT64_MIN);
+    mu_check(Json::load("[9007199254740993]")[0].get_int64() == 9007199254740992LL);
+    bool thrown = false;
+    try {
+        doc["big"].get_int64();
+    } catch(std::out_of_range&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+
+    doc["pi"].set_value(2.5);
+    mu_check(doc["pi"].dump() == "2.5");
+    mu_check(Json::raw_number("1.50").dump() == "1.50");
+    // dumped verbatim, so anything but one number would inject text
+    const char* not_numbers[][2] = { { "1,\"admin\":true", "PARSE_INVALID_VALUE" },
+                                     { "", "PARSE_INVALID_VALUE" },
+                                     { " 1", "PARSE_INVALID_VALUE" },
+                                     { "1 ", "PARSE_INVALID_VALUE" },
+                                     { "0x10", "PARSE_INVALID_VALUE" },
+                                     { "NaN", "PARSE_INVALID_VALUE" },
+                                     { "1e999", "PARSE_NUMBER_TOO_BIG" } };
+    for(auto& c : not_numbers) {
+        std::string error;
+        try {
+            Json::raw_number(c[0]);
+        } catch(const std::logic_error& e) {
+            error = e.what();
+        }
+        mu_check(error == c[1]);
+    }
+    bool embedded_nul = false;
+    try {
+        Json::raw_number(std::string("1\0,2", 4));
+    } catch(const std::logic_error&) {
+        embedded_nul = true;
+    }
+    mu_check(embedded_nul);
+
+    const char* bad[] = { "01", "1.", "-", "+1", "1e" };
+    for(const char* b : bad) {
+        JParseError error;
+        Json::load(b, PARSE_RAW_NUMBERS, error);
+        mu_check(error && std::string(error.code) == "PARSE_INVALID_VALUE");
+    }
+    // out of double range fails as in the default mode
+    std::string huge(400, '9');
+    const char* too_big[] = { "[1e999]", "-1E+400", huge.c_str() };
+    for(const char* b : too_big) {
+        JParseError plain, raw;
+        Json::load(b, PARSE_DEFAULT, plain);
+        Json::load(b, PARSE_RAW_NUMBERS, raw);
+        mu_check(raw && std::string(raw.code) == "PARSE_NUMBER_TOO_BIG");
+        mu_check(plain && std::string(plain.code) == raw.code);
+    }
+    mu_check(Json::load("[1e308, 1e-999]", PARSE_RAW_NUMBERS).dump() == "[1e308,1e-999]");
+}
+
+MU_TEST(test_order_and_hash)
+{
+    Json::Jarray values { Json::load("{\"a\":1}"), Json("x"), Json(2.0), Json(), Json(true),
+                          Json::load("[1]"), Json(1.0), Json(false), Json::load("{}"), Json("") };
+    std::sort(values.begin(), values.end());
+    for(size_t i = 1; i < values.size(); ++i) {
+        mu_check(!(values[i] < values[i-1]));
+        mu_check(values[i-1].get_type() <= values[i].get_type());
+    }
+    mu_check(values[0].is_null());
+    mu_check(values.back() == Json::load("{\"a\":1}"));
+
+    std::set<Json> keys(values.begin(), values.end());
+    keys.insert(Json(2.0));
+    keys.insert(Json::load("[1]"));
+    mu_assert_int_eq(10, (int)keys.size());
+
+    std::hash<Json> h;
+    auto a = Json::load("{\"k\":[1,\"two\",{\"x\":null}],\"n\":-0}");
+    auto b = Json::load("{\"n\":0,\"k\":[1,\"two\",{\"x\":null}]}");
+    mu_check(a == b);
+    mu_check(h(a) == h(b));
+    mu_check(h(Json::load("[1,2]")) != h(Json::load("[2,1]")));
+
+    std::unordered_set<Json> docs { a, b, Json::load("[1,2]"), Json::load("[2,1]") };
+    mu_assert_int_eq(3, (int)docs.size());
+
+    // mutation invalidates a cached hash
+    size_t before = h(a);
+    a["k"][1].set_value("three");
+    mu_check(h(a) != before);
+    JPointer("/k/2/x").set(a, 1.0);
+    mu_check(h(a) == h(Json::load("{\"k\":[1,\"three\",{\"x\":1}],\"n\":0}")));
+
+    // so do changes made through a held reference, a copy of a child
+    // handle or JPointer, none of which pass through the hashed parent
+    Json& k = a["k"];
+    before = h(a);
+    k[2]["x"].set_value(2.0);
+    mu_check(h(a) != before && h(a) == h(Json::load(a.dump())));
+    Json x = a["k"][2];
+    before = h(a);
+    x.insert_or_assign("y", Json(true));
+    mu_check(h(a) != before && h(a) == h(Json::load(a.dump())));
+    before = h(a);
+    JPointer("/n").find(a)->set_value(5.0);
+    mu_check(h(a) != before && h(a) == h(Json::load(a.dump())));
+    before = h(a);
+    JPointer("/k/0").get(a) = Json("one");
+    mu_check(h(a) != before && h(a) == h(Json::load(a.dump())));
+    // a child replaced by a new node, likely at the freed one's address
+    Json doc = Json::load("{\"a\":1,\"b\":2}");
+    Json& first = doc["a"];
+    before = h(doc);
+    first = Json();
+    first = Json(7.0);
+    mu_check(h(doc) != before && h(doc) == h(Json::load("{\"a\":7,\"b\":2}")));
+    before = h(doc);
+    *JPointer("/a").find(doc) = Json();
+    *JPointer("/a").find(doc) = Json(8.0);
+    mu_check(h(doc) != before && h(doc) == h(Json::load("{\"a\":8,\"b\":2}")));
+}
+
+struct Address {
+    std::string city;
+    std::vector<int> zip;
+    CCJSON_FIELDS(city, zip)
+};
+
+struct Person {
+    std::string name;
+    double score = 0;
+    bool active = false;
+    Address address;
+    std::vector<Address> history;
+    std::map<std::string, int> counters;
+    Json extra;
+    CCJSON_FIELDS(name, score, active, address, history, counters, extra)
+};
+
+MU_TEST(test_struct_binding)
+{
+    std::string ins("{\"name\":\"Ann\\n\",\"unknown\":{\"deep\":[1,2]},\"score\":9.5,\"active\":true,"
+                    "\"address\":{\"city\":\"Rome\",\"zip\":[0,1,2]},"
+                    "\"history\":[{\"city\":\"Oslo\",\"zip\":[]},{\"city\":\"Nice\"}],"
+                    "\"counters\":{\"a\":1,\"b\":2},\"extra\":[null,{\"k\":\"v\"}]}");
+    Person p;
+    json::load(ins, p);
+    mu_check(p.name == "Ann\n");
+    mu_assert_double_eq(9.5, p.score);
+    mu_check(p.active);
+    mu_check(p.address.city == "Rome");
+    mu_assert_int_eq(3, (int)p.address.zip.size());
+    mu_assert_int_eq(2, p.address.zip[2]);
+    mu_assert_int_eq(2, (int)p.history.size());
+    mu_check(p.history[1].city == "Nice");
+    mu_assert_int_eq(2, p.counters["b"]);
+    mu_check(p.extra[1]["k"].get_string() == "v");
+
+    // the binding writer agrees with the DOM
+    std::string out = json::dump(p);
+    Person q;
+    json::load(out, q);
+    mu_check(json::dump(q) == out);
+    mu_check(Json::load(out)["history"][0]["city"].get_string() == "Oslo");
+
+    bool thrown = false;
+    try {
+        json::load("{\"score\":\"high\"}", p);
+    } catch(const std::runtime_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+
+    thrown = false;
+    try {
+        std::vector<int> v;
+        json::load("[1,2", v);
+    } catch(const std::logic_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+
+    // integers take whole numbers that fit, anything else is a parse error
+    std::vector<int64_t> wide;
+    json::load("[-9223372036854775808, 4e15, 7]", wide);
+    mu_check(wide[0] == INT64_MIN && wide[1] == 4000000000000000LL && wide[2] == 7);
+    const char* codes[][2] = { { "[3.7]", "PARSE_NUMBER_NOT_INTEGER" },
+                               { "[2147483648]", "PARSE_NUMBER_OUT_OF_RANGE" },
+                               { "[-2147483649]", "PARSE_NUMBER_OUT_OF_RANGE" },
+                               { "[1e300]", "PARSE_NUMBER_OUT_OF_RANGE" } };
+    for(auto& c : codes) {
+        std::string error;
+        try {
+            std::vector<int> v;
+            json::load(c[0], v);
+        } catch(const std::logic_error& e) {
+            error = e.what();
+        }
+        mu_check(error == c[1]);
+    }
+    std::string error;
+    try {
+        std::vector<unsigned char> bytes;
+        json::load("[255, 256]", bytes);
+    } catch(const std::logic_error& e) {
+        error = e.what();
+    }
+    mu_check(error == "PARSE_NUMBER_OUT_OF_RANGE");
+    std::vector<uint64_t> big;
+    json::load("[18446744073709551615, 18446744073709549568, -0]", big);
+    mu_check(big[0] == UINT64_MAX && big[1] == 18446744073709549568ULL && big[2] == 0);
+    mu_check(json::dump(big) == "[18446744073709551615,18446744073709549568,0]");
+    const char* unsigned_codes[][2] = { { "[18446744073709551616]", "PARSE_NUMBER_OUT_OF_RANGE" },
+                                        { "[-1]", "PARSE_NUMBER_OUT_OF_RANGE" },
+                                        { "[1.5]", "PARSE_NUMBER_NOT_INTEGER" } };
+    for(auto& c : unsigned_codes) {
+        std::string error;
+        try {
+            json::load(c[0], big);
+        } catch(const std::logic_error& e) {
+            error = e.what();
+        }
+        mu_check(error == c[1]);
+    }
+
+    // above 2^53 a double would round to the neighbouring even value
+    json::load("[9007199254740993, -9007199254740993, 9223372036854775807]", wide);
+    mu_check(wide[0] == 9007199254740993LL && wide[1] == -9007199254740993LL && wide[2] == INT64_MAX);
+    mu_check(json::dump(wide) == "[9007199254740993,-9007199254740993,9223372036854775807]");
+    std::vector<int64_t> again;
+    json::load(json::dump(wide), again);
+    mu_check(again == wide);
+    std::vector<float> ratios;
+    json::load("[3.7]", ratios);
+    mu_check(ratios[0] == 3.7f);
+}
+
+static void TEST_SCHEMA(const JSchema& schema, const char* json, const char* expect) {
+    std::string error;
+    bool ok = schema.validate(Json::load(json), &error);
+    mu_check(ok == (expect == nullptr));
+    if(expect)
+        mu_assert_string_eq(expect, error.c_str());
+
+    std::string fused;
+    try {
+        Json::load(json, schema);
+    } catch(const std::logic_error& e) {
+        fused = e.what();
+    }
+    mu_check(fused.empty() == (expect == nullptr));
+    if(expect)
+        mu_check(std::string(expect).compare(0, fused.size(), fused) == 0);
+}
+
+MU_TEST(test_json_schema)
+{
+    JSchema schema(Json::load("{\"type\":\"object\",\"required\":[\"id\",\"tags\"],"
+        "\"properties\":{"
+            "\"id\":{\"type\":\"integer\",\"minimum\":1},"
+            "\"ratio\":{\"type\":[\"number\",\"null\"],\"exclusiveMaximum\":1},"
+            "\"name\":{\"type\":\"string\",\"minLength\":1,\"maxLength\":3,\"pattern\":\"^[a-z]+$\"},"
+            "\"kind\":{\"enum\":[\"a\",\"b\",2]},"
+            "\"tags\":{\"type\":\"array\",\"maxItems\":2,\"items\":{\"type\":\"string\"}}}}"));
+
+    TEST_SCHEMA(schema, "{\"id\":3,\"tags\":[]}", nullptr);
+    TEST_SCHEMA(schema, "{\"id\":3,\"tags\":[\"x\"],\"ratio\":null,\"name\":\"abc\",\"kind\":2,\"other\":[1]}", nullptr);
+    TEST_SCHEMA(schema, "[]", "SCHEMA_TYPE_MISMATCH");
+    TEST_SCHEMA(schema, "{\"tags\":[]}", "SCHEMA_MISS_REQUIRED /id");
+    TEST_SCHEMA(schema, "{\"id\":1.5,\"tags\":[]}", "SCHEMA_TYPE_MISMATCH /id");
+    TEST_SCHEMA(schema, "{\"id\":0,\"tags\":[]}", "SCHEMA_BELOW_MINIMUM /id");
+    TEST_SCHEMA(schema, "{\"id\":1,\"tags\":[],\"ratio\":1}", "SCHEMA_ABOVE_MAXIMUM /ratio");
+    TEST_SCHEMA(schema, "{\"id\":1,\"tags\":[],\"name\":\"abcd\"}", "SCHEMA_LENGTH_OUT_OF_RANGE /name");
+    TEST_SCHEMA(schema, "{\"id\":1,\"tags\":[],\"name\":\"aB\"}", "SCHEMA_PATTERN_MISMATCH /name");
+    TEST_SCHEMA(schema, "{\"id\":1,\"tags\":[],\"kind\":\"c\"}", "SCHEMA_NOT_IN_ENUM /kind");
+    TEST_SCHEMA(schema, "{\"id\":1,\"tags\":[\"a\",\"b\",\"c\"]}", "SCHEMA_ITEMS_OUT_OF_RANGE /tags");
+    TEST_SCHEMA(schema, "{\"id\":1,\"tags\":[\"a\",7]}", "SCHEMA_TYPE_MISMATCH /tags/1");
+
+    // inclusive and exclusive bounds both apply, in either key order
+    JSchema both(Json::load("{\"minimum\":0,\"exclusiveMinimum\":5,\"exclusiveMaximum\":10,\"maximum\":8}"));
+    TEST_SCHEMA(both, "3", "SCHEMA_BELOW_MINIMUM");
+    TEST_SCHEMA(both, "5", "SCHEMA_BELOW_MINIMUM");
+    TEST_SCHEMA(both, "6", nullptr);
+    TEST_SCHEMA(both, "8", nullptr);
+    TEST_SCHEMA(both, "9", "SCHEMA_ABOVE_MAXIMUM");
+    JSchema draft4(Json::load("{\"minimum\":1,\"exclusiveMinimum\":true,\"maximum\":2}"));
+    TEST_SCHEMA(draft4, "1", "SCHEMA_BELOW_MINIMUM");
+    TEST_SCHEMA(draft4, "2", nullptr);
+
+    // long strings cannot exhaust the stack in the regex matcher
+    std::string longer = "\"" + std::string(100000, 'a') + "\"";
+    JSchema alternation(Json::load("{\"pattern\":\"^(a|b)*$\"}"));
+#ifdef __GLIBCXX__
+    TEST_SCHEMA(alternation, longer.c_str(), nullptr);
+#else
+    TEST_SCHEMA(alternation, longer.c_str(), "SCHEMA_PATTERN_INPUT_TOO_LONG");
+#endif
+    JSchema backref(Json::load("{\"pattern\":\"^(a)\\\\1*$\"}"));
+    TEST_SCHEMA(backref, "\"aaa\"", nullptr);
+    TEST_SCHEMA(backref, longer.c_str(), "SCHEMA_PATTERN_INPUT_TOO_LONG");
+
+    bool thrown = false;
+    try {
+        JSchema bad(Json::load("{\"type\":\"decimal\"}"));
+    } catch(const std::logic_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+}
+
+MU_TEST(test_memory_usage)
+{
+    auto doc = Json::load("{\"name\":\"a string longer than the small string buffer\","
+                          "\"list\":[1,2,3,true,null],\"nested\":{\"k\":\"v\"}}");
+    JMemoryUsage usage = doc.memory_usage();
+    mu_assert_int_eq(2, (int)usage.types[Json::JOBJECT].nodes);
+    mu_assert_int_eq(1, (int)usage.types[Json::JARRAY].nodes);
+    mu_assert_int_eq(3, (int)usage.types[Json::JNUMBER].nodes);
+    mu_assert_int_eq(2, (int)usage.types[Json::JSTRING].nodes);
+    mu_assert_int_eq(1, (int)usage.types[Json::JBOOL].nodes);
+    mu_assert_int_eq(1, (int)usage.types[Json::JNULL].nodes);
+    mu_assert_int_eq(3 * sizeof(double), (int)usage.types[Json::JNUMBER].payload);
+    mu_assert_int_eq(45, (int)usage.types[Json::JSTRING].payload);
+    mu_assert_int_eq(15, (int)usage.types[Json::JOBJECT].payload);   /* keys */
+    mu_check(usage.types[Json::JARRAY].overhead >= 5 * sizeof(Json));
+    mu_assert_int_eq(0, (int)usage.shared);
+    mu_check(usage.total() > usage.types[Json::JSTRING].payload);
+
+    // a subtree referenced from another document is reported as shared
+    Json nested = doc["nested"];
+    JMemoryUsage with_alias = doc.memory_usage();
+    mu_check(with_alias.shared > 0);
+    mu_check(with_alias.shared < with_alias.total());
+    mu_assert_int_eq((int)usage.total(), (int)with_alias.total());
+
+    // a node reachable twice inside the tree is measured once
+    Json::Jarray twice { nested, nested };
+    mu_assert_int_eq(1, (int)Json(twice).memory_usage().types[Json::JOBJECT].nodes);
+
+    JAllocStats stats = alloc_stats();
+    mu_check(stats.allocations >= stats.deallocations);
+}
+
+MU_TEST(test_node_handles)
+{
+    // a node's reported size is what building it allocated: the node alone
+    // under CCJSON_SINGLE_THREADED, node and control block otherwise
+    size_t before = heap_bytes;
+    Json null_node;
+    size_t null_bytes = heap_bytes - before;
+    before = heap_bytes;
+    Json number(2.5);
+    size_t number_bytes = heap_bytes - before;
+    before = heap_bytes;
+    Json flag(true);
+    size_t flag_bytes = heap_bytes - before;
+    mu_assert_int_eq((int)null_bytes, (int)null_node.memory_usage().total());
+    mu_assert_int_eq((int)number_bytes, (int)number.memory_usage().total());
+    mu_assert_int_eq((int)flag_bytes, (int)flag.memory_usage().total());
+
+    // copies add a reference, moves hand theirs over, and every reference
+    // is dropped again
+    Json doc = Json::load("{\"list\":[1,2],\"n\":3}");
+    mu_assert_int_eq(0, (int)doc.memory_usage().shared);
+    {
+        Json alias = doc["list"];
+        mu_check(doc.memory_usage().shared > 0);
+        Json moved(std::move(alias));
+        Json copy = moved;
+        moved = Json();
+        mu_check(doc.memory_usage().shared > 0);
+        before = heap_allocations;
+        Json a = doc, b = a;
+        b = copy;
+        a = std::move(b);
+        mu_assert_int_eq(0, (int)(heap_allocations - before));
+    }
+    mu_assert_int_eq(0, (int)doc.memory_usage().shared);
+
+    // a node goes with its last handle
+    size_t freed = heap_frees;
+    {
+        Json first(1.0);
+        Json second = first;
+        first = Json();
+        mu_check(heap_frees == freed);
+        mu_assert_double_eq(1, second.get_number());
+    }
+    mu_assert_int_eq(2, (int)(heap_frees - freed));         // the 1.0 and the null
+
+#ifdef CCJSON_SINGLE_THREADED
+    JHandle empty;
+    mu_check(empty.get() == nullptr && empty.use_count() == 0);
+#endif
+}
+
+static void TEST_PARSE_ERROR(const char* code, int line, int column, std::string json) {
+    JParseError error;
+    Json res = Json::load(json, error);
+    mu_check(error);
+    mu_assert_string_eq(code, error.code);
+    mu_assert_int_eq(line, (int)error.line);
+    mu_assert_int_eq(column, (int)error.column);
+    mu_check(res.is_null());
+
+    std::string thrown;
+    try {
+        Json::load(json);
+    } catch(const std::logic_error& e) {
+        thrown = e.what();
+    }
+    mu_check(thrown == code);
+}
+
+MU_TEST(test_parse_error)
+{
+    JParseError error;
+    Json res = Json::load("{\"a\":[1,true,\"x\"]}", error);
+    mu_check(!error);
+    mu_check(res == Json::load("{\"a\":[1,true,\"x\"]}"));
+
+    TEST_PARSE_ERROR("PARSE_EXPECT_VALUE", 1, 1, "");
+    TEST_PARSE_ERROR("PARSE_INVALID_VALUE", 1, 2, "[nul]");
+    TEST_PARSE_ERROR("PARSE_INVALID_VALUE", 1, 2, "[-01]");
+    TEST_PARSE_ERROR("PARSE_ROOT_NOT_SINGULAR", 1, 6, "null x");
+    TEST_PARSE_ERROR("PARSE_MISS_COMMA_OR_SQUARE_BRACKET", 2, 4, "[1,\n 2 3]");
+    TEST_PARSE_ERROR("PARSE_MISS_COMMA_OR_CURLY_BRACKET", 3, 7, "{\n\"a\":1,\n\"b\":2 \"c\"}");
+    TEST_PARSE_ERROR("PARSE_MISS_COLON", 1, 6, "{\"a\" 1}");
+    TEST_PARSE_ERROR("PARSE_MISS_KEY", 1, 2, "{1:1}");
+    TEST_PARSE_ERROR("PARSE_MISS_KEY", 1, 3, "{\"\\x\":1}");
+    TEST_PARSE_ERROR("PARSE_MISS_QUOTATION_MARK", 1, 5, "\"abc");
+    TEST_PARSE_ERROR("PARSE_INVALID_STRING_ESCAPE", 1, 3, "\"a\\qb\"");
+    TEST_PARSE_ERROR("PARSE_INVALID_STRING_CHAR", 1, 3, "\"a\tb\"");
+    TEST_PARSE_ERROR("PARSE_INVALID_UNICODE_HEX", 1, 5, "\"\\u0g00\"");
+    TEST_PARSE_ERROR("PARSE_INVALID_UNICODE_SURROGATE", 1, 8, "\"\\ud800x\"");
+    TEST_PARSE_ERROR("PARSE_NUMBER_TOO_BIG", 1, 1, "1e999");
+    TEST_PARSE_ERROR("EXCEEDED_MAXIMUM_NESTING_DEPTH", 1, 202, std::string(300, '['));
+}
+
+static void TEST_UTF8_ERROR(const char* code, int column, std::string json) {
+    JParseError error;
+    Json::load(json, PARSE_VALIDATE_UTF8, error);
+    mu_check(error);
+    mu_assert_string_eq(code, error.code);
+    mu_assert_int_eq(column, (int)error.column);
+    mu_check(!Json::load(json, error).is_null() && !error);   // passed through by default
+}
+
+MU_TEST(test_utf8_validation)
+{
+    // long enough runs to cross block boundaries
+    std::string text = "[\"plain ascii text longer than one block\", \"caf\xc3\xa9 \xe4\xb8\xad\xe6\x96\x87 "
+                       "\xf0\x9d\x84\x9e and more ascii after it\", \"\\u00e9\\ud834\\udd1e\\n\", "
+                       "\"\xef\xbf\xbd\xf4\x8f\xbf\xbf\"]";
+    Json res = Json::load(text, PARSE_VALIDATE_UTF8);
+    mu_check(res == Json::load(text));
+    std::string s = res[1].get_string();
+    mu_check(s == "caf\xc3\xa9 \xe4\xb8\xad\xe6\x96\x87 \xf0\x9d\x84\x9e and more ascii after it");
+    s = res[2].get_string();
+    mu_check(s == "\xc3\xa9\xf0\x9d\x84\x9e\n");
+
+    TEST_UTF8_ERROR("PARSE_INVALID_UTF8", 3, "\"a\x80\"");                  // lone continuation
+    TEST_UTF8_ERROR("PARSE_INVALID_UTF8", 2, "\"\xc0\xaf\"");                 // overlong
+    TEST_UTF8_ERROR("PARSE_INVALID_UTF8", 2, "\"\xe0\x80\xaf\"");             // overlong
+    TEST_UTF8_ERROR("PARSE_INVALID_UTF8", 2, "\"\xed\xa0\x80\"");             // surrogate
+    TEST_UTF8_ERROR("PARSE_INVALID_UTF8", 2, "\"\xf4\x90\x80\x80\"");         // past U+10FFFF
+    TEST_UTF8_ERROR("PARSE_INVALID_UTF8", 2, "\"\xf5\x80\x80\x80\"");
+    TEST_UTF8_ERROR("PARSE_INVALID_UTF8", 2, "\"\xe4\xb8\"");                 // truncated
+    TEST_UTF8_ERROR("PARSE_INVALID_UTF8", 19, "[\"0123456789abcdef\xff\"]");
+    TEST_UTF8_ERROR("PARSE_INVALID_UNICODE_SURROGATE", 2, "\"\\udc00\"");
+    TEST_UTF8_ERROR("PARSE_MISS_KEY", 3, "{\"\xfe\":1}");
+}
+
+MU_TEST(test_freeze)
+{
+    Json::Jarray hosts;
+    for(int i = 0; i < 64; ++i) {
+        Json::Jobject host;
+        host["port"] = Json(double(8000 + i));
+        host["name"] = Json("node" + std::to_string(i));
+        hosts.push_back(Json(host));
+    }
+    Json::Jobject config;
+    config["hosts"] = Json(hosts);
+    config["debug"] = Json(false);
+    Json doc(config);
+
+    const JSnapshot frozen = doc.freeze();
+    JView root = frozen.root();
+    mu_check(root.to_json() == doc);
+    mu_check(!root.find("debug").get_bool());
+    mu_check(!root.find("missing").valid());
+
+    // readers share the snapshot and copy only views
+    double sums[4] = { 0, 0, 0, 0 };
+    std::vector<std::thread> readers;
+    for(int t = 0; t < 4; ++t) {
+        readers.emplace_back([&root, &sums, t] {
+            for(int round = 0; round < 100; ++round) {
+                JView list = root.find("hosts");
+                for(size_t i = 0; i < list.size(); ++i)
+                    sums[t] += list[i].find("port").get_number();
+            }
+        });
+    }
+    for(auto& reader : readers)
+        reader.join();
+    for(int t = 0; t < 4; ++t)
+        mu_assert_double_eq(100 * (64 * 8000 + 63 * 64 / 2), sums[t]);
+
+    // the source document stays mutable and independent
+    doc["debug"].set_value(true);
+    mu_check(!root.find("debug").get_bool());
+}
+
+MU_TEST(test_builder_moves)
+{
+    // moved strings and containers are adopted, not copied
+    std::string text(100, 'x');
+    size_t before = heap_allocations;
+    Json s(std::move(text));
+    mu_assert_int_eq(1, (int)(heap_allocations - before));     // the node only
+    std::string other(100, 'y');
+    before = heap_allocations;
+    s.set_value(std::move(other));
+    mu_assert_int_eq(0, (int)(heap_allocations - before));
+
+    Json::Jarray items(1000);
+    Json arr = Json(Json::Jarray());
+    before = heap_allocations;
+    arr.set_value(std::move(items));
+    mu_assert_int_eq(0, (int)(heap_allocations - before));
+    mu_assert_int_eq(1000, (int)arr.get_array().size());
+
+    // a move hands the node over, nothing is left sharing it
+    Json target;
+    before = heap_allocations;
+    target = std::move(arr);
+    mu_assert_int_eq(0, (int)(heap_allocations - before));
+    mu_assert_int_eq(0, (int)target.memory_usage().shared);
+    mu_check(arr.is_null());
+
+    // an element moved out of a container leaves a null behind
+    Json list = Json::load(R"({"items":[{"a":1},2]})");
+    Json taken = std::move(list["items"][0]);
+    std::string text_left = list.dump();
+    mu_assert_string_eq("{\"items\":[null,2]}", text_left.c_str());
+    mu_assert_double_eq(1, taken["a"].get_number());
+    list["items"][1] = std::move(taken);
+    mu_check(taken.is_null());
+    mu_assert_double_eq(1, list["items"][1]["a"].get_number());
+
+    // building a document: one allocation per node plus one per object member
+    Json doc = Json(Json::Jarray());
+    doc.reserve(1000);
+    before = heap_allocations;
+    for(int i = 0; i < 1000; ++i) {
+        Json& row = doc.emplace_back(Json::Jobject());
+        row.insert_or_assign("id", Json(double(i)));
+        row.emplace("ok", i % 2 == 0);
+    }
+    mu_assert_int_eq(5 * 1000, (int)(heap_allocations - before));
+    mu_assert_double_eq(999, doc[999]["id"].get_number());
+    mu_check(!doc[999]["ok"].get_bool());
+
+    mu_check(!doc[0].emplace("ok", false).second);             // present, left alone
+    mu_check(doc[0]["ok"].get_bool());
+    doc[0].insert_or_assign("ok", Json(false));
+    mu_check(!doc[0]["ok"].get_bool());
+    doc.push_back(Json("tail"));
+    mu_assert_int_eq(1001, (int)doc.get_array().size());
+
+    bool thrown = false;
+    try {
+        doc.insert_or_assign("k", Json());
+    } catch(const std::runtime_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+}
+
+static void collect_chunk(const char* data, size_t size, void* user) {
+    static_cast<std::vector<std::string>*>(user)->push_back(std::string(data, size));
+}
+
+MU_TEST(test_streaming_writer)
+{
+    std::string out;
+    {
+        JWriter w(out);
+        w.begin_object()
+            .key("name").value("tab\there \"quoted\"")
+            .key("count").value(3)
+            .key("ratio").value(0.5)
+            .key("flags").begin_array().value(true).value(false).null().end_array()
+            .key("empty").begin_object().end_object()
+            .key("nested").begin_array().begin_array().end_array().value(std::string("x")).end_array()
+            .key("dom").value(Json::load("{\"k\":[1,2]}"))
+        .end_object();
+        mu_check(w.done());
+    }
+    std::string expect = "{\"name\":\"tab\\there \\\"quoted\\\"\",\"count\":3,\"ratio\":0.5,"
+                         "\"flags\":[true,false,null],\"empty\":{},\"nested\":[[],\"x\"],\"dom\":{\"k\":[1,2]}}";
+    mu_check(out == expect);
+    mu_assert_int_eq(7, (int)Json::load(out).get_object().size());
+
+    // integers of every width are written exactly, not rounded through double
+    std::string ints;
+    JWriter(ints).begin_array()
+        .value(int64_t(9007199254740993LL)).value(INT64_MIN).value(UINT64_MAX)
+        .value(-7).value(7u).value((unsigned char)255).value(short(-1)).value(2.5f)
+    .end_array();
+    mu_check(ints == "[9007199254740993,-9223372036854775808,18446744073709551615,-7,7,255,-1,2.5]");
+
+    // no allocations once the output has room
+    std::string reserved;
+    reserved.reserve(1024);
+    size_t before = heap_allocations;
+    {
+        JWriter w(reserved);
+        w.begin_array();
+        for(int i = 0; i < 20; ++i)
+            w.begin_object().key("i").value(i).key("s").value("short").end_object();
+        w.end_array();
+    }
+    mu_assert_int_eq(0, (int)(heap_allocations - before));
+    mu_assert_int_eq(20, (int)Json::load(reserved).get_array().size());
+
+    // a sink receives the text in chunks, the rest on destruction
+    std::vector<std::string> chunks;
+    {
+        JWriter w(collect_chunk, &chunks, 16);
+        w.begin_array();
+        for(int i = 0; i < 10; ++i)
+            w.value("0123456789");
+        w.end_array();
+    }
+    mu_check(chunks.size() > 1);
+    std::string joined;
+    for(auto& c : chunks)
+        joined += c;
+    mu_assert_int_eq(10, (int)Json::load(joined).get_array().size());
+}
+
+#if __cplusplus >= 201402L
+static_assert(JLiteral::valid(" {\"a\": [1, -2.5e3, true, null, \"\\u00e9\\ud834\\udd1e\\n\"], \"b\": {}} "), "");
+static_assert(JLiteral::valid("0") && JLiteral::valid("\"\"") && JLiteral::valid("[[]]"), "");
+static_assert(!JLiteral::valid("") && !JLiteral::valid("[1,]") && !JLiteral::valid("{\"a\" 1}"), "");
+static_assert(!JLiteral::valid("01") && !JLiteral::valid("1.") && !JLiteral::valid("nul"), "");
+static_assert(!JLiteral::valid("\"\\ud800\"") && !JLiteral::valid("\"\\x\"") && !JLiteral::valid("[1] 2"), "");
+#endif
+
+static Json literal_defaults() {
+    return CCJSON_LITERAL(R"({"retries": 3, "hosts": ["a", "b"], "tls": {"verify": true}})");
+}
+
+MU_TEST(test_json_literal)
+{
+    Json defaults = literal_defaults();
+    mu_assert_double_eq(3, defaults["retries"].get_number());
+    mu_assert_int_eq(2, (int)defaults["hosts"].get_array().size());
+    mu_check(defaults["tls"]["verify"].get_bool());
+
+    // each evaluation owns its nodes, changing one leaves the literal as written
+    defaults["retries"] = 5.0;
+    defaults["hosts"][1] = "c";
+    defaults["tls"]["verify"] = false;
+    Json fresh = literal_defaults();
+    mu_assert_double_eq(3, fresh["retries"].get_number());
+    mu_check(fresh["hosts"][1].get_string() == "b");
+    mu_check(fresh["tls"]["verify"].get_bool());
+    mu_check(fresh.dump() == "{\"hosts\":[\"a\",\"b\"],\"retries\":3,\"tls\":{\"verify\":true}}");
+}
+
+MU_TEST(test_columns)
+{
+    std::string text = R"([
+        {"id": 1, "price": 2.5, "name": "ab", "skip": {"deep": [1, 2]}},
+        {"id": 9007199254740993, "price": null, "name": "", "extra": "x"},
+        {"name": 7, "price": 4, "id": 1.5},
+        [1, 2],
+        {"id": -3, "id": 4, "name": "first", "name": "second"}
+    ])";
+    JColumns parsed({ {"id", JColumns::INT64}, {"price", JColumns::DOUBLE}, {"name", JColumns::STRING} });
+    parsed.load(text);
+    mu_assert_int_eq(5, (int)parsed.rows());
+    const JColumns::Column& id = *parsed.find("id");
+    mu_check(id.valid(0) && id.ints[0] == 1);
+    mu_check(id.valid(1) && id.ints[1] == 9007199254740993LL);    // exact beyond 2^53
+    mu_check(!id.valid(2) && id.ints[2] == 0);                     // not integral
+    mu_check(!id.valid(3));                                        // not an object
+    mu_check(id.valid(4) && id.ints[4] == 4);                      // last one wins
+    const JColumns::Column& price = parsed[1];
+    mu_check(price.valid(0) && price.doubles[0] == 2.5);
+    mu_check(!price.valid(1) && price.doubles[1] == 0);
+    mu_check(price.valid(2) && price.doubles[2] == 4);
+    const JColumns::Column& name = parsed[2];
+    mu_check(name.string_at(0) == "ab" && name.valid(0));
+    mu_check(name.string_at(1) == "" && name.valid(1));
+    mu_check(name.string_at(2) == "" && !name.valid(2));
+    mu_check(name.string_at(4) == "second");
+    mu_assert_int_eq(6, (int)name.offsets.size());
+    mu_check(name.blob == "absecond");
+    mu_check(parsed.find("extra") == nullptr);
+
+    // the same from a built document, except for int64 precision
+    JColumns built({ {"price", JColumns::DOUBLE}, {"name", JColumns::STRING} });
+    built.append(Json::load(text));
+    mu_check(built[0].doubles == price.doubles && built[0].validity == price.validity);
+    mu_check(built[1].blob == name.blob && built[1].offsets == name.offsets);
+
+    // validity words past the first
+    JColumns many({ {"v", JColumns::DOUBLE} });
+    std::string rows = "[";
+    for(int i = 0; i < 200; ++i)
+        rows += std::string(i ? "," : "") + (i % 3 ? "{\"v\":" + std::to_string(i) + "}" : "{}");
+    many.load(rows + "]");
+    mu_assert_int_eq(4, (int)many[0].validity.size());
+    double sum = 0;
+    for(size_t i = 0; i < many.rows(); ++i)
+        sum += many[0].doubles[i];
+    mu_check(!many[0].valid(198) && many[0].valid(199) && sum == 19900 - 6633);
+    many.clear();
+    mu_assert_int_eq(0, (int)many.rows());
+
+    const char* bad[][2] = {
+        { "[{\"v\":1} {}]", "PARSE_MISS_COMMA_OR_SQUARE_BRACKET" },
+        { "[{\"v\" 1}]", "PARSE_MISS_COLON" },
+        { "[{\"v\":1,}]", "PARSE_MISS_KEY" },
+        { "[{\"v\":01}]", "PARSE_INVALID_VALUE" },
+        { "[] 1", "PARSE_ROOT_NOT_SINGULAR" },
+        { "{}", "NOT_ARRAY" },
+    };
+    for(auto& c : bad) {
+        std::string code;
+        try {
+            many.load(c[0]);
+        } catch(std::exception& e) {
+            code = e.what();
+        }
+        mu_check(code == c[1]);
+    }
+}
+
+MU_TEST(test_parse_cache)
+{
+    JParseCache cache(4096);
+    std::string config = "{\"retries\": 3, \"hosts\": [\"a\", \"b\"]}";
+    std::shared_ptr<const JSnapshot> first = cache.load(config);
+    std::shared_ptr<const JSnapshot> again = cache.load(std::string(config));
+    mu_check(first->root().to_json() == Json::load(config));
+    mu_check(first == again);                                // shared, not reparsed
+    JParseCache::Stats st = cache.stats();
+    mu_check(st.hits == 1 && st.misses == 1 && st.entries == 1);
+    mu_check(st.bytes > config.size() && st.bytes < 4096);
+
+    // a hit read through JView rebuilds nothing, nested lookups included
+    size_t before = heap_allocations;
+    for(int i = 0; i < 100; ++i) {
+        std::shared_ptr<const JSnapshot> hit = cache.load(config);
+        JView root = hit->root();
+        mu_check(root["retries"].get_number() == 3);
+        JView hosts = root.find("hosts");
+        mu_check(hosts.size() == 2 && hosts[1].string_size() == 1 && *hosts[1].string_data() == 'b');
+    }
+    mu_assert_int_eq(0, (int)(heap_allocations - before));
+
+    // hits are read-only; changing a copy leaves the cached document alone
+    Json copy = cache.load(config)->root().to_json();
+    copy["retries"].set_value(99.0);
+    mu_check(cache.load(config)->root()["retries"].get_number() == 3);
+
+    // least recently used goes first
+    for(int i = 0; i < 100; ++i) {
+        cache.load("[" + std::to_string(i) + "]");
+        cache.load(config);
+    }
+    st = cache.stats();
+    mu_check(st.evictions > 0 && st.bytes <= 4096);
+    mu_check(st.hits == 203);
+    cache.load("[99]");
+    mu_check(cache.stats().hits == 204);
+    cache.load("[0]");
+    mu_check(cache.stats().hits == 204);
+
+    bool thrown = false;
+    try {
+        cache.load("[1,");
+    } catch(std::logic_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+
+    cache.set_max_bytes(0);
+    st = cache.stats();
+    mu_check(st.entries == 0 && st.bytes == 0);
+    cache.load(config);
+    mu_check(cache.stats().entries == 0);                  // over the ceiling, not kept
+
+    cache.set_max_bytes(1 << 20);
+    std::vector<std::thread> workers;
+    for(int t = 0; t < 4; ++t)
+        workers.emplace_back([&cache] {
+            for(int i = 0; i < 500; ++i)
+                cache.load("{\"k\": " + std::to_string(i % 10) + "}");
+        });
+    for(auto& w : workers)
+        w.join();
+    st = cache.stats();
+    mu_check(st.entries == 10);
+    mu_check(st.hits + st.misses == 2000 + 308);
+    cache.clear();
+    mu_check(cache.stats().entries == 0);
+}
+
+// hands the text over a few bytes at a time
+struct ChunkedText {
+    std::string text;
+    size_t pos;
+};
+
+static size_t read_chunk(char* buffer, size_t size, void* user) {
+    ChunkedText* in = static_cast<ChunkedText*>(user);
+    size = std::min<size_t>(std::min<size_t>(size, 5), in->text.size() - in->pos);
+    in->text.copy(buffer, size, in->pos);
+    in->pos += size;
+    return size;
+}
+
+MU_TEST(test_element_reader)
+{
+    ChunkedText in { " [1, \"a,]\\\"}\", {\"k\": [[], {}]}, null , -2.5e1] ", 0 };
+    JElementReader reader(read_chunk, &in, 3);
+    mu_check(reader.type() == Json::JARRAY);
+    JElement e;
+    std::string seen;
+    while(reader.next(e))
+        seen += e.key + e.value.dump() + ";";
+    mu_check(seen == "1;\"a,]\\\"}\";{\"k\":[[],{}]};null;-25;");
+    mu_check(!reader.next(e));
+
+    std::string members = "{\"b\": 2, \"a\": {\"x\": \"}\"}, \"b\": 3}";
+    JElementReader object(members.data(), members.size());
+    seen.clear();
+    while(object.next(e))
+        seen += e.key + "=" + e.value.dump() + ";";
+    mu_check(seen == "b=2;a={\"x\":\"}\"};b=3;");
+    JElementReader whole(members.data(), members.size());
+    mu_check(Json::load(whole) == Json::load(members));
+
+    const char* scalars[] = { "\"text\"", " 42 ", "[]", "{ }" };
+    for(const char* text : scalars) {
+        JElementReader r(text, strlen(text));
+        mu_check(Json::load(r) == Json::load(text));
+    }
+
+    // earlier elements come out before the error
+    std::string bad = "[1, 2 3]";
+    JElementReader partial(bad.data(), bad.size());
+    mu_check(partial.next(e) && e.value == Json(1.0));
+    std::string code;
+    try {
+        partial.next(e);
+    } catch(std::logic_error& ex) {
+        code = ex.what();
+    }
+    mu_check(code == "PARSE_MISS_COMMA_OR_SQUARE_BRACKET");
+
+    bad = "[1] x";
+    JElementReader trailing(bad.data(), bad.size());
+    mu_check(trailing.next(e));
+    code.clear();
+    try {
+        trailing.next(e);
+    } catch(std::logic_error& ex) {
+        code = ex.what();
+    }
+    mu_check(code == "PARSE_ROOT_NOT_SINGULAR");
+
+    bool thrown = false;
+    try {
+        JElementReader::open("no/such/file.json");
+    } catch(std::runtime_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+
+#ifdef CCJSON_COROUTINES
+    std::string rows = "[{\"id\": 1}, {\"id\": 2}, {\"id\": 3}]";
+    double sum = 0;
+    for(JElement& row : stream_elements(JElementReader(rows.data(), rows.size())))
+        sum += row.value["id"].get_number();
+    mu_check(sum == 6);
+
+    bad = "[1, 2, }";
+    sum = 0;
+    code.clear();
+    try {
+        for(JElement& row : stream_elements(JElementReader(bad.data(), bad.size())))
+            sum += row.value.get_number();
+    } catch(std::logic_error& ex) {
+        code = ex.what();
+    }
+    mu_check(sum == 3 && code == "PARSE_EXPECT_VALUE");
+#endif
+}
+
+#ifdef CCJSON_ZLIB
+static void write_file(const char* path, const std::string& bytes) {
+    FILE* f = fopen(path, "wb");
+    fwrite(bytes.data(), 1, bytes.size(), f);
+    fclose(f);
+}
+
+MU_TEST(test_gzip_streams)
+{
+    const char* path = "test_gzip.json.gz";
+    Json::Jarray rows;
+    for(int i = 0; i < 20000; ++i)
+        rows.push_back(Json::load("{\"id\":" + std::to_string(i) + ",\"tags\":[\"a,b]\",\"}{\"],\"ok\":true}"));
+    Json doc(rows);
+    doc.dump_gzip(path, 6);
+    FILE* f = fopen(path, "rb");
+    unsigned char magic[2] = { 0, 0 };
+    mu_check(fread(magic, 1, 2, f) == 2);
+    fseek(f, 0, SEEK_END);
+    size_t compressed = ftell(f);
+    fclose(f);
+    mu_check(magic[0] == 0x1f && magic[1] == 0x8b);
+    mu_check(compressed < doc.dump().size() / 10);
+    mu_check(Json::load_gzip(path) == doc);
+
+    Json config = Json::load("{\"name\":\"x\",\"list\":[1,[2,{}]],\"empty\":{}}");
+    config.dump_gzip(path);
+    mu_check(Json::load_gzip(path) == config);
+    Json(Json::Jarray()).dump_gzip(path);
+    mu_check(Json::load_gzip(path) == Json(Json::Jarray()));
+    Json("scalar").dump_gzip(path, 1);
+    mu_check(Json::load_gzip(path) == Json("scalar"));
+
+    write_file(path, " [1, {\"a\": \"]\"}] \n");               // plain text passes through
+    mu_check(Json::load_gzip(path) == Json::load("[1, {\"a\": \"]\"}]"));
+
+    const char* bad[][2] = {
+        { "[1,2", "PARSE_MISS_COMMA_OR_SQUARE_BRACKET" },
+        { "[1 2]", "PARSE_MISS_COMMA_OR_SQUARE_BRACKET" },
+        { "{\"a\" 1}", "PARSE_MISS_COLON" },
+        { "{1:2}", "PARSE_MISS_KEY" },
+        { "[1] 2", "PARSE_ROOT_NOT_SINGULAR" },
+        { "  ", "PARSE_EXPECT_VALUE" },
+    };
+    for(auto& c : bad) {
+        write_file(path, c[0]);
+        std::string code;
+        try {
+            Json::load_gzip(path);
+        } catch(std::logic_error& e) {
+            code = e.what();
+        }
+        mu_check(code == c[1]);
+    }
+    remove(path);
+
+    bool thrown = false;
+    try {
+        Json::load_gzip("no/such/file.gz");
+    } catch(std::runtime_error&) {
+        thrown = true;
+    }
+    mu_check(thrown);
+}
+#endif
+
+static int stats_hook_calls = 0;
+
+static void count_stats_call(const JStats& call, void* user) {
+    ++*static_cast<int*>(user);
+}
+
+MU_TEST(test_stats)
+{
+    reset_stats();
+    set_stats_hook(count_stats_call, &stats_hook_calls);
+    std::string text = "{\"a\":[1,-2.5,\"xy\"],\"b\":{\"c\":null,\"d\":true}}";
+    Json doc = Json::load(text);
+    std::string out = doc.dump();
+    set_stats_hook(nullptr);
+    JStats s = stats();
+#ifdef CCJSON_STATS
+    mu_assert_int_eq(1, (int)s.parse_calls);
+    mu_assert_int_eq((int)text.size(), (int)s.parse_bytes);
+    mu_assert_int_eq(1, (int)s.dump_calls);    // nested values do not count as calls
+    mu_assert_int_eq((int)out.size(), (int)s.dump_bytes);
+    mu_assert_int_eq(2, (int)s.values[Json::JNUMBER]);
+    mu_assert_int_eq(1, (int)s.values[Json::JSTRING]);
+    mu_assert_int_eq(2, (int)s.values[Json::JOBJECT]);
+    mu_assert_int_eq(6, (int)s.string_bytes);   /* "a" "xy" "b" "c" "d" */
+    mu_assert_int_eq(5, (int)s.number_bytes);
+    mu_assert_int_eq(2, (int)s.max_depth);
+    mu_assert_int_eq(2, stats_hook_calls);
+    uint64_t timed = 0;
+    for(int i = 0; i < JStats::buckets; ++i)
+        timed += s.parse_latency[i];
+    mu_assert_int_eq(1, (int)timed);
+
+    try {
+        Json::load("[1,");
+    } catch(const std::logic_error&) {
+    }
+    mu_assert_int_eq(2, (int)stats().parse_calls);
+    reset_stats();
+    mu_assert_int_eq(0, (int)stats().parse_calls);
+#else
+    mu_assert_int_eq(0, (int)s.parse_calls);
+    mu_assert_int_eq(0, (int)s.dump_calls);
+    mu_assert_int_eq(0, stats_hook_calls);
+#endif
+}
+
 MU_TEST_SUITE(parser_suit) {
     MU_RUN_TEST(test_double_parse);
     MU_RUN_TEST(test_string_parse);
@@ -245,6 +1667,32 @@ MU_TEST_SUITE(parser_suit) {
 	MU_RUN_TEST(test_object_parse2_long_string);
 	
     MU_RUN_TEST(test_stringly);
+    MU_RUN_TEST(test_binary_snapshot);
+    MU_RUN_TEST(test_json_pointer);
+    MU_RUN_TEST(test_json_path);
+    MU_RUN_TEST(test_columns);
+    MU_RUN_TEST(test_parse_cache);
+    MU_RUN_TEST(test_element_reader);
+    MU_RUN_TEST(test_projection_parse);
+    MU_RUN_TEST(test_json_patch);
+    MU_RUN_TEST(test_json_diff);
+    MU_RUN_TEST(test_order_and_hash);
+    MU_RUN_TEST(test_raw_numbers);
+    MU_RUN_TEST(test_incremental_dump);
+    MU_RUN_TEST(test_struct_binding);
+    MU_RUN_TEST(test_json_schema);
+    MU_RUN_TEST(test_memory_usage);
+    MU_RUN_TEST(test_node_handles);
+    MU_RUN_TEST(test_stats);
+    MU_RUN_TEST(test_parse_error);
+    MU_RUN_TEST(test_utf8_validation);
+    MU_RUN_TEST(test_freeze);
+    MU_RUN_TEST(test_builder_moves);
+    MU_RUN_TEST(test_streaming_writer);
+    MU_RUN_TEST(test_json_literal);
+#ifdef CCJSON_ZLIB
+    MU_RUN_TEST(test_gzip_streams);
+#endif
 }
 
 int main() {